@@ -0,0 +1,129 @@
+// Ping-pong over loopback TCP, an AF_UNIX socket file and an abstract
+// AF_UNIX address, served by the same TcpServer echo.
+//
+// usage: unix_domain_bench [round trips] [message size] [tcp port]
+
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/Buffer.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThread.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpConnection.h>
+#include <muduo/net/TcpServer.h>
+
+#include <memory>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf);
+}
+
+// blocking client, so only the server side goes through the library
+int connectTo(const InetAddress& addr)
+{
+  int fd = ::socket(addr.family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || ::connect(fd, addr.getSockAddr(), addr.sockLen()) < 0)
+  {
+    LOG_SYSFATAL << "connect " << addr.toIpPort();
+  }
+  if (!addr.isUnix())
+  {
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+  }
+  return fd;
+}
+
+bool readFull(int fd, char* buf, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t n = ::read(fd, buf, len);
+    if (n <= 0)
+    {
+      return false;
+    }
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+void pingPong(EventLoop* loop, const char* name, const InetAddress& addr,
+              int rounds, size_t size)
+{
+  std::unique_ptr<TcpServer> server;
+  CountDownLatch started(1);
+  loop->runInLoop([&] {
+    server.reset(new TcpServer(loop, addr, name));
+    server->setMessageCallback(onMessage);
+    server->start();
+    started.countDown();
+  });
+  started.wait();
+
+  int fd = connectTo(addr);
+  std::vector<char> message(size, 'x');
+  std::vector<char> reply(size);
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < rounds; ++i)
+  {
+    if (::write(fd, message.data(), size) != static_cast<ssize_t>(size)
+        || !readFull(fd, reply.data(), size))
+    {
+      LOG_FATAL << name << " short read or write";
+    }
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  ::close(fd);
+
+  printf("%-10s %8.2f us/round trip %10.0f round trips/s %8.1f MiB/s\n",
+         name, seconds * 1e6 / rounds, rounds / seconds,
+         2.0 * rounds * static_cast<double>(size) / seconds / (1024 * 1024));
+
+  CountDownLatch stopped(1);
+  loop->runInLoop([&] {
+    server.reset();
+    stopped.countDown();
+  });
+  stopped.wait();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 100000;
+  size_t size = argc > 2 ? atoi(argv[2]) : 64;
+  uint16_t port = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : 9981);
+  Logger::setLogLevel(Logger::WARN);
+
+  EventLoopThread loopThread;
+  EventLoop* loop = loopThread.startLoop();
+
+  char path[64];
+  snprintf(path, sizeof path, "/tmp/unix_domain_bench.%d", getpid());
+  char abstractName[64];
+  snprintf(abstractName, sizeof abstractName, "@unix_domain_bench.%d", getpid());
+
+  printf("%d round trips of %zu bytes\n", rounds, size);
+  pingPong(loop, "tcp", InetAddress(port, true), rounds, size);
+  pingPong(loop, "unix", InetAddress::fromUnixPath(path), rounds, size);
+  pingPong(loop, "abstract", InetAddress::fromUnixPath(abstractName), rounds, size);
+}
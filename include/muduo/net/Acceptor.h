@@ -3,8 +3,12 @@
 
 #include <functional>
 
+#include <assert.h>
+
+#include <muduo/base/Types.h>
 #include <muduo/net/Channel.h>
 #include <muduo/net/Socket.h>
+#include <muduo/net/TimerId.h>
 
 namespace muduo
 {
@@ -15,22 +19,60 @@ class EventLoop;
 class InetAddress;
 
 ///
-/// Acceptor of incoming TCP connections.
+/// Acceptor of incoming TCP connections, or AF_UNIX stream connections.
 ///
+/// An AF_UNIX filesystem path is unlinked before bind, in case an
+/// earlier run left it behind, and again when the Acceptor goes away.
+/// SO_REUSEPORT does not apply to AF_UNIX.
 class Acceptor : noncopyable
 {
  public:
   typedef std::function<void (int sockfd, const InetAddress&)> NewConnectionCallback;
+  typedef std::function<void ()> AcceptBatchCallback;
+
+  static const int kDefaultAcceptBatch = 32;
 
   Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport);
+  /// Accepts from the already bound socket @c sharedListenFd, through
+  /// a dup()ed descriptor which this Acceptor owns.
+  Acceptor(EventLoop* loop, int sharedListenFd);
   ~Acceptor();
 
   void setNewConnectionCallback(const NewConnectionCallback& cb)
   { newConnectionCallback_ = cb; }
 
+  /// Called once after a readiness notification delivered one or more
+  /// connections through NewConnectionCallback.
+  void setAcceptBatchCallback(const AcceptBatchCallback& cb)
+  { acceptBatchCallback_ = cb; }
+
+  /// Accept up to @c batch connections per readiness notification,
+  /// stopping early on EAGAIN. 1 means one accept(2) per epoll round trip.
+  void setAcceptBatch(int batch)
+  { assert(batch > 0); acceptBatch_ = batch; }
+
+  /// Watch the listening socket with EPOLLEXCLUSIVE, for several
+  /// Acceptors in different loops sharing one socket.
+  /// Must be called before @c listen
+  void setEpollExclusive(bool on)
+  { assert(!listenning_); acceptChannel_.setExclusive(on); }
+
+  EventLoop* getLoop() const { return loop_; }
   bool listenning() const { return listenning_; }
   void listen();
 
+  /// Stop/resume watching the listening socket, pending connections
+  /// wait in the kernel backlog meanwhile. Must be called in loop thread.
+  void pause();
+  void resume();
+  /// pause() now and resume() after @c seconds.
+  void pauseFor(double seconds);
+  bool paused() const { return paused_; }
+
+  int listenFd() const { return acceptSocket_.fd(); }
+  /// Advanced interface, for SO_REUSEPORT tuning before listen().
+  Socket* acceptSocket() { return &acceptSocket_; }
+
  private:
   void handleRead();
 
@@ -38,8 +80,13 @@ class Acceptor : noncopyable
   Socket acceptSocket_;
   Channel acceptChannel_;
   NewConnectionCallback newConnectionCallback_;
+  AcceptBatchCallback acceptBatchCallback_;
+  int acceptBatch_;
   bool listenning_;
+  bool paused_;
+  TimerId resumeTimer_;
   int idleFd_;
+  string unlinkPath_;  // AF_UNIX socket file this Acceptor created
 };
 
 }
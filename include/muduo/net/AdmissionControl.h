@@ -0,0 +1,78 @@
+#ifndef MUDUO_NET_ADMISSIONCONTROL_H
+#define MUDUO_NET_ADMISSIONCONTROL_H
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Mutex.h>
+#include <muduo/net/OpenHashMap.h>
+
+#include "noncopyable.h"
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class InetAddress;
+
+///
+/// Decides whether TcpServer keeps a freshly accepted connection.
+///
+/// Refusing right after accept(2) is a close(2), far cheaper than letting
+/// an overloaded loop take one more connection.
+/// Thread safe, acceptors on several loops may share one.
+class AdmissionControl : noncopyable
+{
+ public:
+  struct Options
+  {
+    Options()
+      : maxConnections(0),
+        maxConnectionsPerIp(0),
+        maxLoopLagSeconds(0.0),
+        pauseAcceptOnLag(false),
+        pauseSeconds(0.1)
+    { }
+
+    int maxConnections;       // 0 means unlimited
+    int maxConnectionsPerIp;  // 0 means unlimited, IPv4 peers only
+    double maxLoopLagSeconds; // 0 means no lag shedding, see EventLoop::lagMicroSeconds()
+    bool pauseAcceptOnLag;    // also stop accepting for pauseSeconds when shedding on lag
+    double pauseSeconds;
+  };
+
+  enum Verdict
+  {
+    kAdmit,
+    kRejectMaxConnections,
+    kRejectPerIp,
+    kRejectLoopLag,
+    kNumVerdicts,
+  };
+
+  explicit AdmissionControl(const Options& options);
+
+  const Options& options() const { return options_; }
+
+  /// Counts the connection if admitted, it must be released later.
+  /// @c ioLoop is the loop the connection would be assigned to.
+  Verdict admit(const InetAddress& peerAddr, const EventLoop* ioLoop);
+  void release(const InetAddress& peerAddr);
+
+  int numConnections() const { return numConnections_.get(); }
+  /// How many accepted connections got @c verdict so far.
+  int64_t numVerdicts(Verdict verdict) const
+  { return verdicts_[verdict].get(); }
+
+ private:
+  const Options options_;
+  mutable AtomicInt32 numConnections_;
+  mutable AtomicInt64 verdicts_[kNumVerdicts];
+  MutexLock mutex_;
+  OpenHashMap<int> perIp_;  // @GuardedBy mutex_, key is ip in network order
+};
+
+}
+}
+
+#endif  // MUDUO_NET_ADMISSIONCONTROL_H
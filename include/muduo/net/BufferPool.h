@@ -0,0 +1,79 @@
+#ifndef MUDUO_NET_BUFFERPOOL_H
+#define MUDUO_NET_BUFFERPOOL_H
+
+#include <muduo/net/TimerId.h>
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class Buffer;
+class EventLoop;
+
+///
+/// Drained Buffers of one EventLoop, for reuse by its connections.
+///
+/// A TcpConnection holds a buffer only while it has bytes in it, so
+/// idle connections cost no buffer memory. Buffers that grew past
+/// maxPooledCapacity are freed instead of pooled, or shrunk if they
+/// still hold a few bytes, and every trimIntervalSeconds the pool frees
+/// the buffers nobody took during the whole interval.
+/// Loop-confined, see EventLoop::bufferPool().
+class BufferPool : noncopyable
+{
+ public:
+  struct Options
+  {
+    Options()
+      : maxPooledCapacity(256 * 1024),
+        trimIntervalSeconds(10.0)
+    { }
+
+    size_t maxPooledCapacity;
+    double trimIntervalSeconds;
+  };
+
+  explicit BufferPool(EventLoop* loop, const Options& options = Options());
+  ~BufferPool();
+
+  void setOptions(const Options& options)
+  { options_ = options; }
+
+  /// An empty buffer, pooled or new.
+  std::unique_ptr<Buffer> get();
+  /// Takes back a buffer with no readable bytes.
+  void put(std::unique_ptr<Buffer> buf);
+  /// put() if @c *buf is drained, else shrinks it if its capacity is
+  /// over maxPooledCapacity and kShrinkRatio times its readable bytes,
+  /// e.g. a partial frame left in a buffer a burst grew to megabytes.
+  void reclaim(std::unique_ptr<Buffer>* buf);
+
+  size_t numFree() const { return free_.size(); }
+  int64_t numCreated() const { return numCreated_; }
+  int64_t numShrunk() const { return numShrunk_; }
+
+  static const size_t kShrinkRatio = 8;
+
+ private:
+  void trim();
+
+  EventLoop* loop_;
+  Options options_;
+  std::vector<std::unique_ptr<Buffer>> free_;  // most recently used last
+  size_t minFree_;  // low water mark of free_ since the last trim
+  int64_t numCreated_;
+  int64_t numShrunk_;
+  bool trimming_;
+  TimerId trimTimer_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_BUFFERPOOL_H
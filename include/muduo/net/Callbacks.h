@@ -61,6 +61,14 @@ typedef std::function<void (const TcpConnectionPtr&,
                             Buffer*,
                             Timestamp)> MessageCallback;
 
+class UdpSocket;
+struct UdpMessage;
+// a batch of datagrams read by one recvmmsg(2), valid during the call only
+typedef std::function<void (UdpSocket*,
+                            const UdpMessage*,
+                            size_t,
+                            Timestamp)> UdpMessageCallback;
+
 void defaultConnectionCallback(const TcpConnectionPtr& conn);
 void defaultMessageCallback(const TcpConnectionPtr& conn,
                             Buffer* buffer,
@@ -1,6 +1,7 @@
 #ifndef _MUDUO_NET_CHANNEL_H_
 #define _MUDUO_NET_CHANNEL_H_
 #include<muduo/base/Timestamp.h>
+#include<muduo/net/ChannelHandler.h>
 #include "noncopyable.h"
 
 #include<memory>
@@ -15,30 +16,35 @@ public://tepydef
     typedef std::function<void()> EventCallBackFunc;
     typedef std::function<void(Timestamp)> ReadEventCallBackFunc;
 
-private://数据成员
-    EventLoop * loop_;//这个Channel归属于哪个EventLoop管理
+private:
+    struct Callbacks;//set*Callback()的回调，第一次设置时才分配
+
+private://数据成员，每次事件分发都要用的放在前面，同在一个cache line
+    ChannelHandler* handler_;//事件的接收者，TcpConnection本身或者callbacks_
     const int  fd_;//该Channel管理的fd
     int        events_;//当前Channel关心的事件
     int revents_;//活跃的事件
     int        index_;//提高Poller效率的，不重要
+    bool tied_;
+    bool eventHandling_;//当前Channel是否处于handleEvent()函数中，即是否正在处理事件
+    bool addedToLoop_;//当前Channel是否已处于EventLoop中
+    bool exclusive_;//注册到epoll时是否带EPOLLEXCLUSIVE，多个epoll监听同一个fd时只唤醒其中一个
+    bool edgeTriggered_;//是否以EPOLLET注册，读写兴趣一次注册，之后开关只改events_
+    bool edgeArmed_;//边沿触发时，当前是否已注册在epoll中
     bool       logHup_;
+    EventLoop * loop_;//这个Channel归属于哪个EventLoop管理
+    std::weak_ptr<void> tie_;
+    std::unique_ptr<Callbacks> callbacks_;
     static const int kNoneEvent;
     static const int kReadEvent;
     static const int kWriteEvent;
 
-    //std::weak_ptr<void> tie_;
-    //bool tied_;
-    bool eventHandling_;//当前Channel是否处于handleEvent()函数中，即是否正在处理事件
-    bool addedToLoop_;//当前Channel是否已处于EventLoop中
-
-    //Channel事件响应时分别调用的回调函数：
-    ReadEventCallBackFunc readCallback_;
-    EventCallBackFunc writeCallback_;
-    EventCallBackFunc closeCallback_;
-    EventCallBackFunc errorCallback_;
-
 private://私有成员函数
+    Callbacks& callbacks();
     void update();/**注册或者更新Channel*/
+    void handleEventWithGuard(Timestamp activeTime);
+    void enable(int event);
+    void disable(int event);
 
 public://共有成员函数
     Channel(EventLoop * loop,int fd);
@@ -47,22 +53,30 @@ public://共有成员函数
     /**事件回调函数**/ 
     void handleEvent(Timestamp activeTime);
 
-    //对外提供的，TCPConnection或者Acceptor中调用他们注册他们自己的回调函数
-    void setReadCallback(ReadEventCallBackFunc cb)
-    { readCallback_ = std::move(cb); }
-    void setWriteCallback(EventCallBackFunc cb)
-    { writeCallback_ = std::move(cb); }
-    void setCloseCallback(EventCallBackFunc cb)
-    { closeCallback_ = std::move(cb); }
-    void setErrorCallback(EventCallBackFunc cb)
-    { errorCallback_ = std::move(cb); }
+    /// Dispatches every event to @c handler through one virtual call,
+    /// instead of the std::function callbacks below.
+    /// The handler must outlive its registration, see tie().
+    void setEventHandler(ChannelHandler* handler) { handler_ = handler; }
+
+    //对外提供的，Acceptor等调用他们注册他们自己的回调函数，与setEventHandler()二选一
+    void setReadCallback(ReadEventCallBackFunc cb);
+    void setWriteCallback(EventCallBackFunc cb);
+    void setCloseCallback(EventCallBackFunc cb);
+    void setErrorCallback(EventCallBackFunc cb);
 
 
-    void enableReading() { events_ |= kReadEvent; update(); }//添加可读事件
-    void disableReading() { events_ &= ~kReadEvent; update(); }//取消可读事件
-    void enableWriting() { events_ |= kWriteEvent; update(); }//添加可写事件
-    void disableWriting() { events_ &= ~kWriteEvent; update(); }//取消可写事件
+    void enableReading() { enable(kReadEvent); }//添加可读事件
+    void disableReading() { disable(kReadEvent); }//取消可读事件
+    void enableWriting() { enable(kWriteEvent); }//添加可写事件
+    void disableWriting() { disable(kWriteEvent); }//取消可写事件
     void disableAll() { events_ = kNoneEvent; update(); }//取消全部事件监听
+    /// enableWriting() right after a write came up short: the socket is
+    /// full, so the next EPOLLOUT edge is still to come and
+    /// edge-triggered mode needs no EPOLL_CTL_MOD.
+    void enableWritingAfterShortWrite();
+    /// Edge-triggered: have epoll report the current readiness once more,
+    /// for a condition that may already hold, e.g. below TCP_NOTSENT_LOWAT.
+    void rearm();
 
     bool isWriting() const { return events_ & kWriteEvent; }
     bool isReading() const { return events_ & kReadEvent; }
@@ -75,6 +89,26 @@ public://共有成员函数
     void set_index(int idx) { index_ = idx; }
     int interested_events() const { return events_; }
     bool isNoneEvent() const { return events_ == kNoneEvent; }
+    /// Register with EPOLLEXCLUSIVE, so only one of the loops watching
+    /// the same file is woken. Set before the first enableReading(),
+    /// epoll allows it on EPOLL_CTL_ADD only. PollPoller ignores it.
+    void setExclusive(bool on) { exclusive_ = on; }
+    bool isExclusive() const { return exclusive_; }
+    /// Registers read and write interest with EPOLLET once. Disabling an
+    /// event then only stops its callback, no syscall, and enabling it
+    /// again re-arms it with one EPOLL_CTL_MOD, so an edge missed in
+    /// between is not lost. The owner must read or write till EAGAIN on
+    /// every callback. Set before the first enable, with a Poller that
+    /// supportsEdgeTriggered().
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+    bool isEdgeTriggered() const { return edgeTriggered_; }
+    /// The events the Poller registers: interested_events(), or all of
+    /// them plus EPOLLET in edge-triggered mode.
+    int registered_events() const;
+    /// Tie this channel to the owner object managed by shared_ptr,
+    /// prevent the owner object being destroyed in handleEvent.
+    /// Costs a weak_ptr lock, two atomic operations, per event; owners on
+    /// a hot path keep themselves alive instead, see TcpConnection.
     void tie(const std::shared_ptr<void>&);
 };
 }
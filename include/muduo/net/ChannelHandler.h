@@ -0,0 +1,31 @@
+#ifndef MUDUO_NET_CHANNELHANDLER_H
+#define MUDUO_NET_CHANNELHANDLER_H
+
+#include <muduo/base/Timestamp.h>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Receiver of a Channel's events, see Channel::setEventHandler().
+///
+/// One pointer in the Channel instead of four std::function callbacks,
+/// for owners with many channels such as TcpConnection.
+class ChannelHandler
+{
+ public:
+  virtual void handleRead(Timestamp receiveTime) = 0;
+  virtual void handleWrite() = 0;
+  virtual void handleClose() = 0;
+  virtual void handleError() = 0;
+
+ protected:
+  ~ChannelHandler() { }  // not deleted through this interface
+};
+
+}
+}
+
+#endif  // MUDUO_NET_CHANNELHANDLER_H
@@ -0,0 +1,47 @@
+#ifndef _MUDUO_NET_CLOCK_H_
+#define _MUDUO_NET_CLOCK_H_
+#include <muduo/base/Timestamp.h>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Cheaper sources of the current time, as a Timestamp since the Epoch.
+///
+/// kMonotonicCoarse and kTsc are anchored to gettimeofday once per
+/// process and then advance with CLOCK_MONOTONIC_COARSE or the CPU's
+/// time stamp counter: no syscall, and they do not follow later steps
+/// of the wall clock. kMonotonicCoarse ticks at the kernel's jiffy
+/// resolution, 1 to 4 ms. kTsc needs an invariant TSC and falls back
+/// to kGettimeofday without one.
+/// Thread safe.
+class Clock
+{
+ public:
+  enum Source
+  {
+    kGettimeofday,
+    kMonotonicCoarse,
+    kTsc,
+  };
+
+  static Timestamp now(Source source)
+  {
+    return source == kGettimeofday ? Timestamp::now() : anchoredNow(source);
+  }
+
+  /// kGettimeofday, or what the MUDUO_CLOCK environment variable names:
+  /// "coarse" or "tsc".
+  static Source defaultSource();
+
+  static bool tscUsable();
+
+ private:
+  static Timestamp anchoredNow(Source source);
+};
+
+}
+}
+#endif
@@ -0,0 +1,128 @@
+#ifndef MUDUO_NET_CONNECTIONPOOL_H
+#define MUDUO_NET_CONNECTIONPOOL_H
+
+#include <muduo/base/Types.h>
+#include <muduo/net/Callbacks.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/SocketProfile.h>
+#include <muduo/net/TimerId.h>
+
+#include "noncopyable.h"
+
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class TcpClient;
+
+///
+/// Warm outbound connections from one EventLoop to a set of backends.
+///
+/// Keeps at least minIdle connections per backend established ahead of
+/// demand, each one a TcpClient reconnecting with backoff, and lends
+/// them out with checkout() / checkin(). Loop-confined: a pool belongs
+/// to one loop and is used from its thread only, so no locking; give
+/// every I/O loop its own pool.
+///
+/// A checked out connection is the caller's to set a message callback
+/// on, checkin() puts the pool's back, which closes the connection if
+/// bytes arrive while it is idle.
+class ConnectionPool : noncopyable
+{
+ public:
+  /// NULL if no connection became available in time.
+  typedef std::function<void (const TcpConnectionPtr&)> CheckoutCallback;
+
+  struct Options
+  {
+    Options()
+      : minIdle(2),
+        maxConnections(16),
+        checkoutTimeoutSeconds(1.0),
+        initRetryDelayMs(100),
+        maxRetryDelayMs(5000)
+    { }
+
+    int minIdle;         // per backend
+    int maxConnections;  // per backend, idle, lent out or connecting
+    double checkoutTimeoutSeconds;
+    int initRetryDelayMs;  // reconnect backoff, see Connector
+    int maxRetryDelayMs;
+    SocketProfile socketProfile;
+  };
+
+  ConnectionPool(EventLoop* loop,
+                 const std::vector<InetAddress>& backends,
+                 const string& nameArg,
+                 const Options& options = Options());
+  /// Waiters get NULL, idle connections are closed, lent out ones stay open.
+  ~ConnectionPool();
+
+  /// Opens minIdle connections to every backend.
+  void start();
+
+  /// Calls @c cb with an idle connection, backends taken round robin,
+  /// before returning if one is idle. Otherwise opens one more if
+  /// allowed and calls @c cb when a connection is established or
+  /// checked in, whichever comes first.
+  void checkout(const CheckoutCallback& cb);
+  /// Gives back a connection from checkout(). It is closed, and
+  /// replaced, if it has unread input.
+  void checkin(const TcpConnectionPtr& conn);
+
+  size_t numIdle() const;
+  size_t numWaiters() const { return waiters_.size(); }
+
+ private:
+  struct Backend
+  {
+    explicit Backend(const InetAddress& a)
+      : addr(a), numConnected(0)
+    { }
+
+    InetAddress addr;
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    std::vector<TcpConnectionPtr> idle;  // most recently used last
+    int numConnected;
+  };
+
+  struct Waiter
+  {
+    int64_t id;
+    CheckoutCallback cb;
+    TimerId timer;
+  };
+
+  void addClient(size_t index);
+  void replenish(size_t index);
+  bool grow();
+  void lend(const TcpConnectionPtr& conn);
+  void onConnection(size_t index, const TcpConnectionPtr& conn);
+  /// static: a connection lent out when the pool is destroyed may
+  /// still hold it.
+  static void onIdleMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp);
+  void onCheckoutTimeout(int64_t id);
+
+  EventLoop* loop_;
+  const string name_;
+  const Options options_;
+  std::vector<Backend> backends_;
+  size_t next_;  // round robin
+  int nextClientId_;
+  bool started_;
+  std::deque<Waiter> waiters_;
+  int64_t nextWaiterId_;
+  std::unordered_map<TcpConnection*, size_t> backendOf_;  // established connections
+};
+
+}
+}
+
+#endif  // MUDUO_NET_CONNECTIONPOOL_H
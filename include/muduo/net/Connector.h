@@ -0,0 +1,81 @@
+#ifndef MUDUO_NET_CONNECTOR_H
+#define MUDUO_NET_CONNECTOR_H
+
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TimerId.h>
+
+#include "noncopyable.h"
+
+#include <functional>
+#include <memory>
+
+namespace muduo
+{
+namespace net
+{
+
+class Channel;
+class EventLoop;
+
+///
+/// Non-blocking connect(2), retried with exponential backoff.
+///
+/// The retry delay starts at initRetryDelayMs and doubles up to
+/// maxRetryDelayMs, restart() goes back to the initial delay.
+class Connector : noncopyable,
+                  public std::enable_shared_from_this<Connector>
+{
+ public:
+  typedef std::function<void (int sockfd)> NewConnectionCallback;
+
+  Connector(EventLoop* loop, const InetAddress& serverAddr);
+  ~Connector();
+
+  void setNewConnectionCallback(const NewConnectionCallback& cb)
+  { newConnectionCallback_ = cb; }
+
+  /// Before @c start.
+  void setRetryDelay(int initRetryDelayMs, int maxRetryDelayMs)
+  { initRetryDelayMs_ = initRetryDelayMs; maxRetryDelayMs_ = maxRetryDelayMs;
+    retryDelayMs_ = initRetryDelayMs; }
+
+  const InetAddress& serverAddress() const { return serverAddr_; }
+
+  void start();  // can be called in any thread
+  void restart();  // must be called in loop thread
+  void stop();  // can be called in any thread
+
+ private:
+  enum States { kDisconnected, kConnecting, kConnected };
+  static const int kMaxRetryDelayMs = 30*1000;
+  static const int kInitRetryDelayMs = 500;
+
+  void setState(States s) { state_ = s; }
+  void startInLoop();
+  void stopInLoop();
+  void connect();
+  void connecting(int sockfd);
+  void handleWrite();
+  void handleError();
+  void retry(int sockfd);
+  int removeAndResetChannel();
+  void resetChannel();
+
+  EventLoop* loop_;
+  InetAddress serverAddr_;
+  bool connect_; // atomic
+  States state_;  // FIXME: use atomic variable
+  std::unique_ptr<Channel> channel_;
+  NewConnectionCallback newConnectionCallback_;
+  int initRetryDelayMs_;
+  int maxRetryDelayMs_;
+  int retryDelayMs_;
+  TimerId retryTimer_;
+};
+
+typedef std::shared_ptr<Connector> ConnectorPtr;
+
+}
+}
+
+#endif  // MUDUO_NET_CONNECTOR_H
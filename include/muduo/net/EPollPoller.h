@@ -17,19 +17,24 @@ public:
 private:
     int epollfd_;
     EventList events_;//用于epoll_wait的传入传出参数，保存内核响应的事件集合
+    bool havePwait2_;//内核是否支持epoll_pwait2，第一次ENOSYS后置为false
 
     static const int kInitEventListSize = 64;
     void fillActiveChannels(int numEvents,
                             ChannelList* activeChannels) const;
     void update(int operation, Channel* channel);
+    Timestamp afterWait(int numEvents, int savedErrno, ChannelList* activeChannels);
 
 public:
     EPollPoller(EventLoop *loop);
     virtual ~EPollPoller();
 
     virtual Timestamp poll(int timeoutMs, ChannelList* activeChannels);
+    /// Uses epoll_pwait2(2) for sub-millisecond timeouts, Linux 5.11 or later.
+    virtual Timestamp pollMicroSeconds(int64_t timeoutUs, ChannelList* activeChannels);
     virtual void updateChannel(Channel* channel);
     virtual void removeChannel(Channel* channel);
+    virtual bool supportsEdgeTriggered() const { return true; }
 };
 }
 }
@@ -9,6 +9,7 @@
 #include "muduo/base/Mutex.h"
 #include "muduo/base/CurrentThread.h"
 #include "muduo/base/Timestamp.h"
+#include "muduo/net/Clock.h"
 #include "muduo/net/TimerId.h"
 
 #include "TimerQueue.h"
@@ -17,6 +18,7 @@
 namespace muduo{
 namespace net{
 
+class BufferPool;
 class Channel;
 class Poller;
 class TimerQueue;
@@ -34,8 +36,13 @@ private://私有数据成员
     int64_t iteration_;
     const pid_t threadId_;//(*this)所属的线程真实id
     Timestamp pollReturnTime_;
+    Clock::Source clockSource_;//本loop读取时间的方式
+    Timestamp now_;//每轮循环缓存的当前时间
+    bool trackLag_;//是否统计每次循环处理事件和任务的耗时
+    std::atomic<int64_t> busySince_;//当前这轮循环开始处理的时刻(微秒)，在poll里阻塞时为0
     std::unique_ptr<Poller> poller_;//一个EventLoop始终持有一个Poller
     std::unique_ptr<TimerQueue> timerQueue_;//这个reactor的定时器集合，一个EventLoop一个TimerQueue
+    std::unique_ptr<BufferPool> bufferPool_;//本loop的连接共用的空闲Buffer,第一次用到时创建;先于timerQueue_析构
     int wakeupFd_;//就是eventfd,实现线程唤醒,其他线程通过往loop.eventfd里写数据来唤醒持有这个loop的线程
     std::unique_ptr<Channel> wakeupChannel_;//eventfd对应的Channel,这个特殊的Channel的生存周期归当前eventloop对象管理
 
@@ -78,6 +85,11 @@ public://共有成员函数
     /// Safe to call from other threads.
     void runInLoop(Functor cb);
 
+    /// Like runInLoop(), and returns after cb has run.
+    /// For setting up and tearing down loop-confined objects of other
+    /// loops; the loop must be running unless called in its own thread.
+    void runInLoopAndWait(const Functor& cb);
+
     /// Queues callback in the loop thread.
     /// Runs after finish pooling.
     /// Safe to call from other threads.
@@ -89,6 +101,21 @@ public://共有成员函数
     /// Time when poll returns, usually means data arrival.
     Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+    /// Current time cached by the loop, read once per iteration when poll
+    /// returns, and again before timers run in the timerfd-less mode.
+    /// No syscall, for timestamping messages in handlers.
+    /// Must be called in the loop thread.
+    Timestamp now() const { return now_; }
+
+    /// Reads this loop's clock afresh. Safe to call from other threads.
+    Timestamp clockNow() const { return Clock::now(clockSource_); }
+
+    /// Chooses where clockNow() and the cached now() come from,
+    /// Clock::defaultSource() unless set. Timers run on the same clock.
+    /// Set it in the loop thread before other threads add timers.
+    void setClockSource(Clock::Source source);
+    Clock::Source clockSource() const { return clockSource_; }
+
     /// Runs callback at 'time'.
     /// Safe to call from other threads.
     TimerId runAt(Timestamp time, TimerCallback cb);
@@ -105,10 +132,32 @@ public://共有成员函数
     /// Safe to call from other threads.
     void cancel(TimerId timerId);
 
+    /// Keeps timers in a hierarchical timing wheel ticking every
+    /// @c tickSeconds, O(1) add and cancel, up to one tick late.
+    /// 0 goes back to the default ordered storage.
+    /// Must be called in the loop thread.
+    void setTimingWheel(double tickSeconds);
+
+    /// Allows every timer of this loop to fire up to @c slackSeconds late
+    /// so nearby expirations share one wakeup and timerfd reprogramming
+    /// is skipped when it would not change much. 0 by default.
+    /// Must be called in the loop thread.
+    void setTimerSlack(double slackSeconds);
+
+    /// Fires the timers of this loop from the poll timeout instead of a
+    /// timerfd, no timerfd reads and reprogramming. Pending timers stay.
+    /// On by default if the MUDUO_TIMER_POLL_TIMEOUT environment variable
+    /// is set. Must be called in the loop thread, not from a timer callback.
+    void setTimerPollTimeout(bool on);
+    bool timerPollTimeout() const;
+
     /***用来管理Channel的成员函数*******/
     void updateChannel(Channel* channel);
     void removeChannel(Channel* channel);
     bool hasChannel(Channel* channel);
+    /// Whether channels of this loop may use Channel::setEdgeTriggered(),
+    /// true with epoll, false with poll.
+    bool supportsEdgeTriggered() const;
 
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
@@ -123,6 +172,21 @@ public://共有成员函数
 
     bool eventHandling() const { return eventHandling_; }
 
+    /// Record when each iteration starts handling events and pending
+    /// functors, for lagMicroSeconds(). Reuses the poll return time, no
+    /// extra clock read. Must be called in the loop thread.
+    void setLagTracking(bool on) { trackLag_ = on; }
+
+    /// How far behind this loop is running: the time spent so far in the
+    /// iteration in progress, 0 while it is waiting in poll. Always 0
+    /// without setLagTracking().
+    /// Safe to call from other threads.
+    int64_t lagMicroSeconds() const;
+
+    /// Drained buffers shared by the connections of this loop,
+    /// created at the first call. Must be called in the loop thread.
+    BufferPool* bufferPool();
+
 
     static EventLoop* getEventLoopOfCurrentThread();
 
@@ -6,6 +6,7 @@
 #include <muduo/base/StringPiece.h>
 
 #include <netinet/in.h>
+#include <sys/un.h>
 
 namespace muduo
 {
@@ -13,7 +14,7 @@ namespace net
 {
 
 ///
-/// Wrapper of sockaddr_in.
+/// Wrapper of sockaddr_in, or sockaddr_un for AF_UNIX stream sockets.
 ///
 /// This is an POD interface class.
 class InetAddress : public muduo::copyable
@@ -30,16 +31,41 @@ class InetAddress : public muduo::copyable
   /// Constructs an endpoint with given struct @c sockaddr_in
   /// Mostly used when accepting new connections
   InetAddress(const struct sockaddr_in& addr)
-    : addr_(addr)
+    : addr_(addr),
+      len_(static_cast<socklen_t>(sizeof addr))
   { }
 
+  /// Constructs an endpoint from what accept(2) or getsockname(2)
+  /// returned, AF_INET or AF_UNIX.
+  InetAddress(const struct sockaddr* addr, socklen_t len);
+
+  /// AF_UNIX endpoint at filesystem @c path, or in the abstract
+  /// namespace when @c path starts with '@'.
+  static InetAddress fromUnixPath(StringArg path);
+
+  /// Address the socket @c sockfd is bound to.
+  static InetAddress localAddressOf(int sockfd);
+  /// Address the socket @c sockfd is connected to.
+  static InetAddress peerAddressOf(int sockfd);
+
+  sa_family_t family() const { return addr_.sin_family; }
+  bool isUnix() const { return family() == AF_UNIX; }
+  /// '@' prefixed for an abstract name, empty if unnamed.
+  string unixPath() const;
+
+  /// "unix:" followed by unixPath() for AF_UNIX.
   string toIp() const;
   string toIpPort() const;
 
   // default copy/assignment are Okay
 
   const struct sockaddr_in& getSockAddrInet() const { return addr_; }
-  void setSockAddrInet(const struct sockaddr_in& addr) { addr_ = addr; }
+  void setSockAddrInet(const struct sockaddr_in& addr)
+  { addr_ = addr; len_ = static_cast<socklen_t>(sizeof addr); }
+
+  /// For bind(2)/connect(2) of either family.
+  const struct sockaddr* getSockAddr() const;
+  socklen_t sockLen() const { return len_; }
 
   uint32_t ipNetEndian() const { return addr_.sin_addr.s_addr; }
   uint16_t portNetEndian() const { return addr_.sin_port; }
@@ -51,7 +77,12 @@ class InetAddress : public muduo::copyable
   // static std::vector<InetAddress> resolveAll(const char* hostname, uint16_t port = 0);
 
  private:
-  struct sockaddr_in addr_;
+  union
+  {
+    struct sockaddr_in addr_;
+    struct sockaddr_un unixAddr_;
+  };
+  socklen_t len_;  // abstract AF_UNIX names are told apart by length
 };
 
 }
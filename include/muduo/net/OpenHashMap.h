@@ -0,0 +1,174 @@
+#ifndef MUDUO_NET_OPENHASHMAP_H
+#define MUDUO_NET_OPENHASHMAP_H
+
+#include <muduo/base/copyable.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Compact hash map from non-zero uint64_t keys to @c Value.
+///
+/// Open addressing with linear probing in one flat array, no per-node
+/// allocation. Erase shifts the following entries back instead of
+/// leaving tombstones, so lookups never slow down with churn.
+/// Key 0 marks an empty slot and cannot be stored.
+/// Not thread safe.
+template<typename Value>
+class OpenHashMap : public muduo::copyable
+{
+ public:
+  typedef std::pair<uint64_t, Value> Entry;
+
+  explicit OpenHashMap(size_t initialCapacity = 16)
+    : size_(0)
+  {
+    size_t capacity = 8;
+    while (capacity < initialCapacity)
+    {
+      capacity *= 2;
+    }
+    entries_.resize(capacity);
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  Value* find(uint64_t key)
+  {
+    assert(key != 0);
+    for (size_t i = slotOf(key); ; i = next(i))
+    {
+      if (entries_[i].first == key)
+        return &entries_[i].second;
+      if (entries_[i].first == 0)
+        return NULL;
+    }
+  }
+
+  const Value* find(uint64_t key) const
+  {
+    return const_cast<OpenHashMap*>(this)->find(key);
+  }
+
+  /// Inserts a value-initialized entry if @c key is absent.
+  Value& operator[](uint64_t key)
+  {
+    assert(key != 0);
+    if ((size_ + 1) * 2 > entries_.size())
+    {
+      grow();
+    }
+    size_t i = slotOf(key);
+    while (entries_[i].first != 0 && entries_[i].first != key)
+    {
+      i = next(i);
+    }
+    if (entries_[i].first == 0)
+    {
+      entries_[i].first = key;
+      ++size_;
+    }
+    return entries_[i].second;
+  }
+
+  /// @return number of entries erased, 0 or 1.
+  size_t erase(uint64_t key)
+  {
+    assert(key != 0);
+    size_t i = slotOf(key);
+    while (entries_[i].first != key)
+    {
+      if (entries_[i].first == 0)
+        return 0;
+      i = next(i);
+    }
+    // backward shift: pull up later entries of the run which may
+    // live in the hole, so every run stays contiguous.
+    size_t hole = i;
+    for (size_t j = next(i); entries_[j].first != 0; j = next(j))
+    {
+      size_t home = slotOf(entries_[j].first);
+      bool movable = (hole <= j) ? (home <= hole || home > j)
+                                 : (home <= hole && home > j);
+      if (movable)
+      {
+        entries_[hole] = std::move(entries_[j]);
+        hole = j;
+      }
+    }
+    entries_[hole].first = 0;
+    entries_[hole].second = Value();
+    --size_;
+    return 1;
+  }
+
+  void clear()
+  {
+    for (Entry& entry : entries_)
+    {
+      entry.first = 0;
+      entry.second = Value();
+    }
+    size_ = 0;
+  }
+
+  void swap(OpenHashMap& rhs)
+  {
+    entries_.swap(rhs.entries_);
+    std::swap(size_, rhs.size_);
+  }
+
+  /// Calls f(key, value) for every entry, in no particular order.
+  /// @c f must not insert or erase.
+  template<typename Func>
+  void forEach(Func f)
+  {
+    for (Entry& entry : entries_)
+    {
+      if (entry.first != 0)
+        f(entry.first, entry.second);
+    }
+  }
+
+ private:
+  size_t slotOf(uint64_t key) const
+  {
+    // Fibonacci hashing, spreads sequential ids and IPs of one subnet
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & (entries_.size() - 1);
+  }
+
+  size_t next(size_t i) const
+  {
+    return (i + 1) & (entries_.size() - 1);
+  }
+
+  void grow()
+  {
+    std::vector<Entry> old(entries_.size() * 2);
+    old.swap(entries_);
+    size_ = 0;
+    for (Entry& entry : old)
+    {
+      if (entry.first != 0)
+        (*this)[entry.first] = std::move(entry.second);
+    }
+  }
+
+  std::vector<Entry> entries_;
+  size_t size_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_OPENHASHMAP_H
@@ -18,6 +18,8 @@ public:
   virtual ~PollPoller();
 
   virtual Timestamp poll(int timeoutMs, ChannelList* activeChannels);
+  /// Uses ppoll(2), microsecond timeouts.
+  virtual Timestamp pollMicroSeconds(int64_t timeoutUs, ChannelList* activeChannels);
   virtual void updateChannel(Channel* channel);
   virtual void removeChannel(Channel* channel);
 
@@ -25,6 +27,7 @@ public:
   //根据活跃事件设置对应的Channel
   void fillActiveChannels(int numEvents,
                           ChannelList* activeChannels) const;
+  Timestamp afterWait(int numEvents, int savedErrno, ChannelList* activeChannels);
 
   PollFdList pollfds_;
 };
@@ -1,6 +1,5 @@
 #ifndef _MUDUO_NET_POLLER_H_
 #define _MUDUO_NET_POLLER_H_
-#include <map>
 #include <vector>
 #include<memory>
 
@@ -17,13 +16,26 @@ class Poller:public noncopyable{//虚基类
 
 public:
     typedef std::vector<Channel *> ChannelList;//Poller所管理的Channel的列表
-    typedef std::map<int, Channel*> ChannelMap;
+    typedef std::vector<Channel *> ChannelTable;//以fd为下标，fd是内核分配的最小可用整数，足够稠密
 
 private:
     EventLoop* ownerLoop_;//一个Poller被一个EventLoop所拥有
+    ChannelTable channels_;
+    size_t numChannels_;
 
 protected:
-    ChannelMap channels_;
+    /// O(1) lookup by fd, NULL if not registered
+    Channel* findChannel(int fd) const
+    {
+        size_t idx = static_cast<size_t>(fd);
+        return idx < channels_.size() ? channels_[idx] : NULL;
+    }
+    /// O(1), allocates only when fd goes past the largest fd seen so far
+    void addChannelEntry(Channel* channel);
+    void removeChannelEntry(Channel* channel);
+    size_t numChannels() const { return numChannels_; }
+    /// The owner loop's clock, for the poll return time.
+    Timestamp clockNow() const { return ownerLoop_->clockNow(); }
 public:
     Poller(EventLoop* loop);
     virtual ~Poller();
@@ -33,6 +45,11 @@ public:
     /// Must be called in the loop thread.
     virtual Timestamp poll(int timeoutMs, ChannelList* activeChannels) = 0;//被EventLoop::loop()调用
 
+    /// Same as poll() with the timeout in microseconds, negative waits
+    /// forever. The default rounds up to whole milliseconds.
+    /// Must be called in the loop thread.
+    virtual Timestamp pollMicroSeconds(int64_t timeoutUs, ChannelList* activeChannels);
+
     /// Changes the interested I/O events.
     /// Must be called in the loop thread.
     virtual void updateChannel(Channel* channel) = 0;//被EventLoop::updateChannel()调用
@@ -43,6 +60,9 @@ public:
 
     virtual bool hasChannel(Channel* channel) const;
 
+    /// Whether Channel::setEdgeTriggered() works with this poller.
+    virtual bool supportsEdgeTriggered() const { return false; }
+
     /**这个函数定义在DefalutPoller.c++中，默认返回指向堆上的EpollPoller的指针**/
     static Poller * newDefaultPoller(EventLoop* loop);//在EventLoop中被调用，生成专属于它的Poller实例
 
@@ -0,0 +1,110 @@
+#ifndef MUDUO_NET_RATELIMITER_H
+#define MUDUO_NET_RATELIMITER_H
+
+#include <muduo/base/Timestamp.h>
+#include <muduo/base/copyable.h>
+
+#include "noncopyable.h"
+
+#include <algorithm>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Token bucket refilled at @c rate tokens per second up to @c burst.
+///
+/// Tokens go negative when more is taken than there was, the debt is
+/// repaid by later refills, so a caller may take a whole read first
+/// and wait afterwards. A rate of 0 means unlimited.
+class TokenBucket : public muduo::copyable
+{
+ public:
+  TokenBucket()
+    : rate_(0.0), burst_(0.0), tokens_(0.0)
+  { }
+
+  TokenBucket(double rate, double burst)
+    : rate_(rate), burst_(burst), tokens_(burst)
+  { }
+
+  bool limited() const { return rate_ > 0.0; }
+  double burst() const { return burst_; }
+
+  /// Tokens at @c now, negative while in debt.
+  double available(Timestamp now)
+  {
+    if (lastRefill_.valid())
+    {
+      double elapsed = timeDifference(now, lastRefill_);
+      tokens_ = std::min(burst_, tokens_ + std::max(elapsed, 0.0) * rate_);
+    }
+    lastRefill_ = now;
+    return tokens_;
+  }
+
+  void take(double n) { tokens_ -= n; }
+
+  /// Seconds till there are @c n tokens, 0 if there are.
+  double secondsUntil(double n) const
+  { return tokens_ >= n ? 0.0 : (n - tokens_) / rate_; }
+
+ private:
+  double rate_;
+  double burst_;
+  double tokens_;
+  Timestamp lastRefill_;
+};
+
+///
+/// Rates of RateLimiter, 0 for unlimited.
+struct RateLimit
+{
+  RateLimit()
+    : readBytesPerSecond(0.0),
+      writeBytesPerSecond(0.0),
+      messagesPerSecond(0.0),
+      burstSeconds(1.0)
+  { }
+
+  bool limited() const
+  { return readBytesPerSecond > 0.0 || writeBytesPerSecond > 0.0 || messagesPerSecond > 0.0; }
+
+  double readBytesPerSecond;
+  double writeBytesPerSecond;
+  /// message callbacks, i.e. reads that delivered data
+  double messagesPerSecond;
+  /// bucket size, in seconds of the rate
+  double burstSeconds;
+};
+
+///
+/// Token buckets for bytes in, bytes out and messages of one connection,
+/// or of all connections of one EventLoop sharing it.
+/// Loop-confined, no locking.
+class RateLimiter : noncopyable
+{
+ public:
+  explicit RateLimiter(const RateLimit& limit)
+    : readBytes_(limit.readBytesPerSecond, limit.readBytesPerSecond * limit.burstSeconds),
+      writeBytes_(limit.writeBytesPerSecond, limit.writeBytesPerSecond * limit.burstSeconds),
+      messages_(limit.messagesPerSecond,
+                std::max(1.0, limit.messagesPerSecond * limit.burstSeconds))
+  { }
+
+  TokenBucket& readBytes() { return readBytes_; }
+  TokenBucket& writeBytes() { return writeBytes_; }
+  TokenBucket& messages() { return messages_; }
+
+ private:
+  TokenBucket readBytes_;
+  TokenBucket writeBytes_;
+  TokenBucket messages_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_RATELIMITER_H
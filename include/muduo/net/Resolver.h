@@ -0,0 +1,133 @@
+#ifndef MUDUO_NET_RESOLVER_H
+#define MUDUO_NET_RESOLVER_H
+
+#include <muduo/base/Timestamp.h>
+#include <muduo/base/Types.h>
+#include <muduo/net/Channel.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TimerId.h>
+
+#include "noncopyable.h"
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+
+///
+/// Non-blocking DNS resolver of IPv4 addresses, the asynchronous
+/// counterpart of InetAddress::resolve().
+///
+/// Sends A queries over UDP through a Channel of its loop, retries on
+/// timeout, and caches answers for their TTL. Concurrent lookups of one
+/// name share a query. /etc/hosts and search domains are not consulted,
+/// numeric addresses are answered at once.
+class Resolver : noncopyable
+{
+ public:
+  /// Addresses carry the port passed to resolve(), empty on failure.
+  typedef std::function<void(const std::vector<InetAddress>&)> Callback;
+
+  struct Options
+  {
+    Options()
+      : timeoutSeconds(1.0),
+        retries(2),
+        maxTtlSeconds(3600),
+        maxCacheEntries(10000)
+    { }
+
+    double timeoutSeconds;  // per attempt
+    int retries;            // resends after the first attempt
+    int maxTtlSeconds;      // caps the TTL of cached answers, 0 disables the cache
+    size_t maxCacheEntries;
+  };
+
+  /// Constructed and destroyed in the loop thread.
+  /// Uses the first IPv4 nameserver in /etc/resolv.conf, 127.0.0.1 without one.
+  explicit Resolver(EventLoop* loop, const Options& options = Options());
+  Resolver(EventLoop* loop, const InetAddress& nameserver,
+           const Options& options = Options());
+  ~Resolver();  // pending lookups are dropped
+
+  const InetAddress& nameserver() const { return nameserver_; }  // in the loop thread
+  /// Sends further queries to @c nameserver, e.g. a stand-in in tests.
+  /// Pending queries go there on their next attempt. In the loop thread.
+  void setNameserver(const InetAddress& nameserver);
+
+  /// Calls @c cb in the loop thread, before returning if the answer is
+  /// cached and resolve() is called in the loop thread.
+  /// Thread safe, a call queued by another thread is dropped if the
+  /// Resolver is destroyed before it runs.
+  void resolve(const string& hostname, uint16_t port, Callback cb);
+  /// Not to be waited for in the loop thread.
+  std::future<std::vector<InetAddress>> resolve(const string& hostname,
+                                                uint16_t port);
+
+  size_t cacheSize() const { return cache_.size(); }  // in the loop thread
+  int64_t numQueriesSent() const { return numQueriesSent_; }  // in the loop thread
+  void clearCache();  // in the loop thread
+
+ private:
+  struct Waiter
+  {
+    uint16_t port;
+    Callback cb;
+  };
+
+  struct Query
+  {
+    string hostname;
+    std::vector<Waiter> waiters;
+    TimerId timer;
+    int attempts;
+  };
+
+  struct CacheEntry
+  {
+    std::vector<uint32_t> ips;  // network order
+    Timestamp expiration;
+  };
+
+  typedef std::unordered_map<uint16_t, Query> QueryMap;
+
+  static void resolveIfAlive(const std::weak_ptr<Resolver*>& handle,
+                             const string& hostname, uint16_t port, const Callback& cb);
+  void resolveInLoop(const string& hostname, uint16_t port, const Callback& cb);
+  void send(uint16_t id, const Query& query);
+  void handleRead(Timestamp receiveTime);
+  void onResponse(const char* packet, size_t len, Timestamp receiveTime);
+  void onTimeout(uint16_t id);
+  void finish(QueryMap::iterator it, const std::vector<uint32_t>& ips);
+  void addToCache(const string& hostname, const std::vector<uint32_t>& ips,
+                  uint32_t ttlSeconds, Timestamp now);
+  uint16_t nextId();
+
+  static void deliver(const std::vector<uint32_t>& ips, const Waiter& waiter);
+
+  EventLoop* loop_;
+  const Options options_;
+  InetAddress nameserver_;
+  const int sockfd_;
+  Channel channel_;
+  uint32_t idState_;  // xorshift state, message ids are not guessable in sequence
+  int64_t numQueriesSent_;
+  QueryMap queries_;  // by DNS message id
+  std::unordered_map<string, uint16_t> queryOfName_;
+  std::unordered_map<string, CacheEntry> cache_;
+  // reset in the loop thread by the dtor, where queued calls lock it
+  const std::shared_ptr<Resolver*> handle_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_RESOLVER_H
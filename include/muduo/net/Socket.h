@@ -15,6 +15,7 @@ namespace net
 {
 
 class InetAddress;
+struct SocketProfile;
 
 ///
 /// Wrapper of socket file descriptor.
@@ -68,6 +69,53 @@ class Socket : boost::noncopyable
   ///
   void setKeepAlive(bool on);
 
+  ///
+  /// Set TCP_FASTOPEN on a listening socket, @c queueLength pending
+  /// TFO requests allowed, 0 disables.
+  ///
+  void setFastOpen(int queueLength);
+
+  ///
+  /// Set TCP_DEFER_ACCEPT, wake accept only once data arrived
+  ///
+  void setDeferAccept(int seconds);
+
+  ///
+  /// Set TCP_NOTSENT_LOWAT
+  ///
+  void setNotSentLowat(int bytes);
+
+  ///
+  /// Set SO_RCVBUF / SO_SNDBUF
+  ///
+  void setRecvBuffer(int bytes);
+  void setSendBuffer(int bytes);
+
+  ///
+  /// Enable/disable TCP_QUICKACK
+  ///
+  void setQuickAck(bool on);
+
+  ///
+  /// Apply the listener options of @c profile, before listen().
+  /// @c tcp false skips TCP level options, for AF_UNIX.
+  void applyListenerProfile(const SocketProfile& profile, bool tcp);
+  /// Apply the connection options of @c profile.
+  void applyConnectionProfile(const SocketProfile& profile, bool tcp);
+
+  ///
+  /// Set SO_INCOMING_CPU, prefer this socket for packets handled on @c cpu
+  ///
+  void setIncomingCpu(int cpu);
+
+  ///
+  /// Attach a SO_ATTACH_REUSEPORT_CBPF program to this socket's SO_REUSEPORT
+  /// group which picks socket (cpu % groupSize) for a new connection,
+  /// where cpu is the CPU handling the incoming SYN.
+  /// Sockets are numbered in the order they called listen().
+  /// @return true on success.
+  bool attachReusePortCpuSteering(int groupSize);
+
  private:
   const int sockfd_;
 };
@@ -0,0 +1,66 @@
+#ifndef MUDUO_NET_SOCKETPROFILE_H
+#define MUDUO_NET_SOCKETPROFILE_H
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Socket options a TcpServer or TcpClient applies, declared once.
+///
+/// Listener options go on the listening socket before listen(2),
+/// connection options on every accepted or connected socket.
+/// A zero or false field leaves the kernel default alone.
+/// TCP level options are skipped for AF_UNIX.
+struct SocketProfile
+{
+  SocketProfile()
+    : fastOpenQueue(0),
+      deferAcceptSeconds(0),
+      recvBuffer(0),
+      sendBuffer(0),
+      tcpNoDelay(false),
+      keepAlive(true),
+      quickAck(false),
+      notSentLowat(0)
+  { }
+
+  /// Request/response traffic: one round trip less per connection with
+  /// TFO and DEFER_ACCEPT, no Nagle or delayed first ACK, and at most
+  /// 16KiB queued unsent in the kernel.
+  static SocketProfile lowLatency()
+  {
+    SocketProfile profile;
+    profile.fastOpenQueue = 256;
+    profile.deferAcceptSeconds = 1;
+    profile.tcpNoDelay = true;
+    profile.quickAck = true;
+    profile.notSentLowat = 16 * 1024;
+    return profile;
+  }
+
+  // listener
+  int fastOpenQueue;       // TCP_FASTOPEN, pending TFO requests allowed
+  int deferAcceptSeconds;  // TCP_DEFER_ACCEPT, accept only once data arrived
+
+  // listener, inherited by accepted sockets, and connection.
+  // Setting them turns off the kernel's buffer autotuning.
+  int recvBuffer;  // SO_RCVBUF
+  int sendBuffer;  // SO_SNDBUF
+
+  // connection
+  bool tcpNoDelay;  // TCP_NODELAY
+  bool keepAlive;   // SO_KEEPALIVE
+  bool quickAck;    // TCP_QUICKACK, not sticky, TcpConnection sets it after every read
+  /// TCP_NOTSENT_LOWAT: the socket polls writable only while fewer bytes
+  /// than this sit unsent in the kernel. TcpConnection then holds the
+  /// write complete callback back till the kernel queue drains below it,
+  /// so producers refill just in time instead of filling the send buffer.
+  int notSentLowat;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_SOCKETPROFILE_H
@@ -8,18 +8,26 @@ namespace muduo
 {
 namespace net
 {
+struct TcpStats;
+
 namespace sockets
 {
 
 ///
-/// Creates a non-blocking socket file descriptor,
-/// abort if any error.
-int createNonblockingOrDie();
+/// Creates a non-blocking stream socket file descriptor,
+/// TCP for AF_INET, abort if any error.
+int createNonblockingOrDie(sa_family_t family = AF_INET);
+/// Same for a datagram socket, UDP for AF_INET.
+int createDgramNonblockingOrDie(sa_family_t family = AF_INET);
 
 int  connect(int sockfd, const struct sockaddr_in& addr);
+int  connect(int sockfd, const struct sockaddr* addr, socklen_t addrlen);
 void bindOrDie(int sockfd, const struct sockaddr_in& addr);
+void bindOrDie(int sockfd, const struct sockaddr* addr, socklen_t addrlen);
 void listenOrDie(int sockfd);
 int  accept(int sockfd, struct sockaddr_in* addr);
+/// *addrlen is the size of *addr on entry, the address length on return.
+int  accept(int sockfd, struct sockaddr* addr, socklen_t* addrlen);
 ssize_t read(int sockfd, void *buf, size_t count);
 ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
 ssize_t write(int sockfd, const void *buf, size_t count);
@@ -38,6 +46,9 @@ int getSocketError(int sockfd);
 struct sockaddr_in getLocalAddr(int sockfd);
 struct sockaddr_in getPeerAddr(int sockfd);
 bool isSelfConnect(int sockfd);
+/// TCP_INFO of @c sockfd as numbers, false on error.
+/// Uses the kernel's struct tcp_info, longer than glibc's.
+bool getTcpStats(int sockfd, struct TcpStats* stats);
 
 }
 }
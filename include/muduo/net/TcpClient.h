@@ -0,0 +1,103 @@
+#ifndef MUDUO_NET_TCPCLIENT_H
+#define MUDUO_NET_TCPCLIENT_H
+
+#include <muduo/base/Mutex.h>
+#include <muduo/net/SocketProfile.h>
+#include <muduo/net/TcpConnection.h>
+
+#include "noncopyable.h"
+
+namespace muduo
+{
+namespace net
+{
+
+class Connector;
+typedef std::shared_ptr<Connector> ConnectorPtr;
+
+/// TCP client of a single connection, reconnecting if asked to.
+///
+/// This is an interface class, so don't expose too much details.
+class TcpClient : noncopyable
+{
+ public:
+  // TcpClient(EventLoop* loop);
+  // TcpClient(EventLoop* loop, const string& host, uint16_t port);
+  TcpClient(EventLoop* loop,
+            const InetAddress& serverAddr,
+            const string& nameArg);
+  ~TcpClient();  // force out-line dtor, for std::unique_ptr members.
+
+  void connect();
+  void disconnect();
+  void stop();
+
+  TcpConnectionPtr connection() const
+  {
+    MutexLockGuard lock(mutex_);
+    return connection_;
+  }
+
+  EventLoop* getLoop() const { return loop_; }
+  bool retry() const { return retry_; }
+  void enableRetry() { retry_ = true; }
+
+  /// Backoff of the Connector, before @c connect.
+  void setRetryDelay(int initRetryDelayMs, int maxRetryDelayMs);
+
+  const string& name() const
+  { return name_; }
+
+  /// Connection options of every connection made, see SocketProfile.
+  /// The default only turns on keepalive.
+  /// Not thread safe, before @c connect.
+  void setSocketProfile(const SocketProfile& profile)
+  { profile_ = profile; }
+
+  /// Edge-triggered epoll, see TcpConnection::setEdgeTriggered().
+  /// Not thread safe, before @c connect.
+  void setEdgeTriggered(bool on)
+  { edgeTriggered_ = on; }
+
+  /// Set connection callback.
+  /// Not thread safe.
+  void setConnectionCallback(ConnectionCallback cb)
+  { connectionCallback_ = std::move(cb); }
+
+  /// Set message callback.
+  /// Not thread safe.
+  void setMessageCallback(MessageCallback cb)
+  { messageCallback_ = std::move(cb); }
+
+  /// Set write complete callback.
+  /// Not thread safe.
+  void setWriteCompleteCallback(WriteCompleteCallback cb)
+  { writeCompleteCallback_ = std::move(cb); }
+
+ private:
+  /// Not thread safe, but in loop
+  void newConnection(int sockfd);
+  /// Not thread safe, but in loop
+  void removeConnection(const TcpConnectionPtr& conn);
+
+  EventLoop* loop_;
+  ConnectorPtr connector_; // avoid revealing Connector
+  const string name_;
+  const std::shared_ptr<const string> connNamePrefix_;  // name_:ip:port
+  ConnectionCallback connectionCallback_;
+  MessageCallback messageCallback_;
+  WriteCompleteCallback writeCompleteCallback_;
+  SocketProfile profile_;
+  bool edgeTriggered_;
+  bool retry_;   // atomic
+  bool connect_; // atomic
+  // always in loop thread
+  uint64_t nextConnId_;
+  mutable MutexLock mutex_;
+  TcpConnectionPtr connection_; // @GuardedBy mutex_
+};
+
+}
+}
+
+#endif  // MUDUO_NET_TCPCLIENT_H
@@ -5,8 +5,11 @@
 #include <muduo/base/Types.h>
 #include <muduo/net/Callbacks.h>
 #include <muduo/net/Buffer.h>
+#include <muduo/net/ChannelHandler.h>
 #include <muduo/net/InetAddress.h>
 
+#include <atomic>
+#include <map>
 #include <memory>
 
 #include <boost/any.hpp>
@@ -22,14 +25,19 @@ namespace net
 
 class Channel;
 class EventLoop;
+class RateLimiter;
 class Socket;
+struct RateLimit;
+struct SocketProfile;
+struct TcpStats;
 
 ///
 /// TCP connection, for both client and server usage.
 ///
 /// This is an interface class, so don't expose too much details.
 class TcpConnection : noncopyable,
-                      public std::enable_shared_from_this<TcpConnection>
+                      public std::enable_shared_from_this<TcpConnection>,
+                      private ChannelHandler
 {
  public:
   /// Constructs a TcpConnection with a connected sockfd
@@ -40,17 +48,29 @@ class TcpConnection : noncopyable,
                 int sockfd,
                 const InetAddress& localAddr,
                 const InetAddress& peerAddr);
+  /// Named *namePrefix + "#" + id, formatted at the first name() call.
+  TcpConnection(EventLoop* loop,
+                uint64_t id,
+                const std::shared_ptr<const string>& namePrefix,
+                int sockfd,
+                const InetAddress& localAddr,
+                const InetAddress& peerAddr);
   ~TcpConnection();
 
-  EventLoop* getLoop() const { return loop_; }
-  const string& name() const { return name_; }
-  const InetAddress& localAddress() const { return localAddr_; }
-  const InetAddress& peerAddress() const { return peerAddr_; }
+  /// Thread safe, but changes on migrateTo().
+  EventLoop* getLoop() const { return loop_.load(std::memory_order_acquire); }
+  /// Unique within its TcpServer, 0 if constructed with a name.
+  uint64_t id() const;
+  const string& name() const;
+  const InetAddress& localAddress() const;
+  const InetAddress& peerAddress() const;
   bool connected() const { return state_ == kConnected; }
   bool disconnected() const { return state_ == kDisconnected; }
   // return true if success.
   bool getTcpInfo(struct tcp_info*) const;
   string getTcpInfoString() const;
+  /// TCP_INFO as numbers, including the fields glibc's tcp_info lacks.
+  bool getTcpStats(struct TcpStats* stats) const;
 
   // void send(string&& message); // C++11
   void send(const void* message, int len);
@@ -62,11 +82,70 @@ class TcpConnection : noncopyable,
   void forceClose();
   void forceCloseWithDelay(double seconds);
   void setTcpNoDelay(bool on);
+  /// Registers the socket with EPOLLET once, read and write interest
+  /// together, so backlog episodes toggle EPOLLOUT without a syscall.
+  /// Reads and writes then run till EAGAIN, at most kEdgeTriggeredRounds
+  /// syscalls per event before yielding to other channels.
+  /// Ignored with a poll(2) loop. Before connectEstablished().
+  void setEdgeTriggered(bool on);
+  bool isEdgeTriggered() const;
+  /// Applies the connection options of @c profile, before
+  /// connectEstablished(). TcpServer and TcpClient call it.
+  void setSocketProfile(const SocketProfile& profile);
   // reading or not
   void startRead();
   void stopRead();
   bool isReading() const { return reading_; }; // NOT thread safe, may race with start/stopReadInLoop
 
+  /// Pauses reading of @c source, this connection if NULL, once the
+  /// output buffer holds @c highMark bytes or more and resumes it when
+  /// it drains to @c lowMark. A proxy passes the connection it relays
+  /// from, so a slow downstream stops the upstream instead of buffering
+  /// without bound. Reading stays off while any of the connections it
+  /// feeds is backlogged or stopRead() is in effect.
+  /// In the loop thread, e.g. from the connection callback.
+  void setFlowControl(size_t highMark, size_t lowMark,
+                      const TcpConnectionPtr& source = TcpConnectionPtr());
+  /// Times reading was paused by flow control, and for how long in total.
+  int64_t numReadPauses() const;
+  double readPausedSeconds() const;
+
+  /// Caps bytes in, bytes out and messages per second of this connection,
+  /// see RateLimiter. A throttled connection stops polling for input
+  /// instead of buffering it, and keeps throttled output in the output
+  /// buffer; a timer resumes either once tokens are back. Buckets refill
+  /// by the loop's cached clock, EventLoop::now(), no clock read per send.
+  /// Before connectEstablished() or in the loop thread.
+  void setRateLimit(const RateLimit& limit);
+  /// Shared limiters, one per EventLoop, read-only once set.
+  typedef std::map<EventLoop*, std::shared_ptr<RateLimiter>> LoopRateLimiters;
+  /// Also draws from the limiter of the current loop in @c limiters,
+  /// shared by connections of that loop to cap their aggregate. A
+  /// limiter is loop-confined, migrateTo() switches to the one of the
+  /// new loop, or to none if @c limiters has none for it.
+  /// Before connectEstablished() or in the loop thread.
+  void setSharedRateLimiters(const std::shared_ptr<const LoopRateLimiters>& limiters);
+  int64_t numReadThrottles() const;
+  int64_t numWriteThrottles() const;
+
+  /// Moves this connection to another EventLoop.
+  ///
+  /// Thread safe. The channel is deregistered from the current loop once
+  /// the callbacks already queued there have run, then re-registered on
+  /// @c loop with its buffers and reading/writing state intact. @c cb, if
+  /// set, is called in @c loop's thread after the move.
+  /// Calls from other threads keep their order across the move: they
+  /// queue on this connection and follow it to @c loop, see runOrdered().
+  void migrateTo(EventLoop* loop,
+                 const ConnectionCallback& cb = ConnectionCallback());
+  /// Times migrateTo() moved this connection. In the loop thread.
+  int64_t numMigrations() const;
+
+  /// Internal use only, called in the new loop's thread after every
+  /// move, before the callback of migrateTo(). TcpServer hands the
+  /// connection to the TcpInfoSampler of that loop with it.
+  void setMigratedCallback(const ConnectionCallback& cb);
+
   void setContext(const boost::any& context)
   { context_ = context; }
 
@@ -76,8 +155,7 @@ class TcpConnection : noncopyable,
   boost::any* getMutableContext()
   { return &context_; }
 
-  void setConnectionCallback(const ConnectionCallback& cb)
-  { connectionCallback_ = cb; }
+  void setConnectionCallback(const ConnectionCallback& cb);
 
   void setMessageCallback(const MessageCallback& cb)
   { messageCallback_ = cb; }
@@ -85,19 +163,24 @@ class TcpConnection : noncopyable,
   void setWriteCompleteCallback(const WriteCompleteCallback& cb)
   { writeCompleteCallback_ = cb; }
 
-  void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark)
-  { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
+  void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark);
 
   /// Advanced interface
-  Buffer* inputBuffer()
-  { return &inputBuffer_; }
+  /// The buffers are taken from EventLoop::bufferPool() when data arrives
+  /// or is queued and go back once drained, so an idle connection holds
+  /// none. These two take one if needed and must be called in the loop
+  /// thread; inputBytes() and outputBytes() do not allocate.
+  Buffer* inputBuffer();
+  Buffer* outputBuffer();
+
+  size_t inputBytes() const
+  { return inputBuffer_ ? inputBuffer_->readableBytes() : 0; }
 
-  Buffer* outputBuffer()
-  { return &outputBuffer_; }
+  size_t outputBytes() const
+  { return outputBuffer_ ? outputBuffer_->readableBytes() : 0; }
 
   /// Internal use only.
-  void setCloseCallback(const CloseCallback& cb)
-  { closeCallback_ = cb; }
+  void setCloseCallback(const CloseCallback& cb);
 
   // called when TcpServer accepts a new connection
   void connectEstablished();   // should be called only once
@@ -105,11 +188,36 @@ class TcpConnection : noncopyable,
   void connectDestroyed();  // should be called only once
 
  private:
+  /// smallest throttled write, so a drained bucket is not polled byte by byte
+  static const size_t kWriteQuantum = 16 * 1024;
+  /// edge-triggered reads or writes per event, for fairness
+  static const int kEdgeTriggeredRounds = 16;
   enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
-  void handleRead(Timestamp receiveTime);
-  void handleWrite();
-  void handleClose();
-  void handleError();
+  struct Cold;
+  typedef std::function<void()> Functor;
+
+  TcpConnection(EventLoop* loop, Cold* cold, int sockfd);
+
+  /// In the loop thread with no call of another thread still queued.
+  bool canRunInLoop() const;
+  /// Runs @c cb in the loop thread after every call queued here before
+  /// it, from any thread, even when a migrateTo() is among them.
+  void runOrdered(const Functor& cb);
+  void drainOrdered();
+  /// Queues @c cb in our loop, or in the one a migrateTo() moved us to
+  /// before it got to run.
+  void queueOnOwnLoop(const Functor& cb);
+  void runOnOwnLoop(const Functor& cb);
+
+  // ChannelHandler
+  virtual void handleRead(Timestamp receiveTime);
+  virtual void handleWrite();
+  virtual void handleClose();
+  virtual void handleError();
+
+  /// edge-triggered, after running out of rounds
+  void continueReading();
+  void continueWriting();
   // void sendInLoop(string&& message);
   void sendInLoop(const StringPiece& message);
   void sendInLoop(const void* message, size_t len);
@@ -120,25 +228,68 @@ class TcpConnection : noncopyable,
   const char* stateToString() const;
   void startReadInLoop();
   void stopReadInLoop();
+  void setChannelHandler();
+  /// channel_ reads iff reading_ and nothing blocks it
+  void updateReadInterest();
+  void blockReadingInLoop(bool on);
+  void setBacklogged(bool on);
+  bool rateLimited() const { return rateLimiter_ || sharedRateLimiter_; }
+  /// Seconds till both limiters have read tokens again, 0 if they have.
+  double readWait(Timestamp now);
+  /// Seconds till @c pending bytes, or kWriteQuantum, may be written.
+  double writeWait(Timestamp now, size_t pending);
+  /// Takes @c bytes and one message, returns readWait()
+  double chargeRead(size_t bytes, Timestamp now);
+  size_t writeAllowance(size_t wanted, Timestamp now);
+  void chargeWrite(size_t bytes);
+  void throttleRead(double seconds);
+  void throttleWrite(double seconds);
+  void resumeRead();
+  void resumeWrite();
+  /// sharedRateLimiter_ of @c loop from setSharedRateLimiters()
+  void updateSharedRateLimiter(EventLoop* loop);
+  /// Takes a buffer from the pool of loop_ if @c buf has none.
+  Buffer* acquire(std::unique_ptr<Buffer>* buf);
+  /// Gives @c buf back to the pool of loop_ if it is drained, or shrinks
+  /// it, see BufferPool::reclaim().
+  void reclaimBuffer(std::unique_ptr<Buffer>* buf);
+  void migrateInLoop(EventLoop* loop, const ConnectionCallback& cb);
+  void attachInLoop(const ConnectionCallback& cb);
 
-  EventLoop* loop_;
-  const string name_;
+  // Hot fields first, read on every event: dispatch reaches them in
+  // the first cache lines after the vptr and the enable_shared_from_this
+  // weak_ptr. Fields touched on setup, teardown or by statistics only
+  // live out of line in cold_.
+  std::atomic<EventLoop*> loop_;  // changes only in its own thread, see migrateTo()
+  std::unique_ptr<Channel> channel_;  // we don't expose Channel to client.
   StateE state_;  // FIXME: use atomic variable
   bool reading_;
-  // we don't expose those classes to client.
-  std::unique_ptr<Socket> socket_;
-  std::unique_ptr<Channel> channel_;
-  const InetAddress localAddr_;
-  const InetAddress peerAddr_;
-  ConnectionCallback connectionCallback_;
+  bool awaitingLowat_;  // output drained, write complete waits for the kernel queue
+  bool backlogged_;     // flow control: between high and low mark, blocking the source
+  bool readThrottled_;  // EPOLLIN off till resumeRead()
+  bool writeThrottled_; // EPOLLOUT off till resumeWrite()
+  bool quickAck_;       // TCP_QUICKACK re-armed after every read
+  int readBlocks_;      // backlogged connections fed by this one
+  int notSentLowat_;    // TCP_NOTSENT_LOWAT, 0 if not set
+  std::atomic<bool> orderedQueued_;  // a drainOrdered() is in flight
+  // Keeps this alive from connectEstablished() to connectDestroyed(), the
+  // span the channel may fire events, instead of a tie() whose weak_ptr
+  // lock costs two atomic operations per event. Loop-confined, so the
+  // callbacks get it by reference with no refcount traffic.
+  TcpConnectionPtr self_;
   MessageCallback messageCallback_;
+  std::unique_ptr<Buffer> inputBuffer_;   // NULL while empty, see acquire()
+  std::unique_ptr<Buffer> outputBuffer_;  // FIXME: use list<Buffer> as output buffer.
   WriteCompleteCallback writeCompleteCallback_;
-  HighWaterMarkCallback highWaterMarkCallback_;
-  CloseCallback closeCallback_;
   size_t highWaterMark_;
-  Buffer inputBuffer_;
-  Buffer outputBuffer_; // FIXME: use list<Buffer> as output buffer.
+  size_t flowHighMark_;  // 0 if off, see setFlowControl()
+  size_t flowLowMark_;
+  // rate limiting, see setRateLimit()
+  std::unique_ptr<RateLimiter> rateLimiter_;
+  std::shared_ptr<RateLimiter> sharedRateLimiter_;  // of loop_, see setSharedRateLimiters()
+  std::unique_ptr<Socket> socket_;
   boost::any context_;
+  std::unique_ptr<Cold> cold_;
   // FIXME: creationTime_, lastReceiveTime_
   //        bytesReceived_, bytesSent_
 };
@@ -0,0 +1,93 @@
+#ifndef MUDUO_NET_TCPINFOSAMPLER_H
+#define MUDUO_NET_TCPINFOSAMPLER_H
+
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/Callbacks.h>
+#include <muduo/net/TcpStats.h>
+#include <muduo/net/TimerId.h>
+
+#include "noncopyable.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+
+///
+/// Reads TCP_INFO of the connections of one EventLoop every interval.
+///
+/// A pass over all connections is cut into slices run by one timer,
+/// so a loop with many connections spends a little time every slice
+/// instead of one long stall per interval. Connections are held by
+/// weak_ptr and dropped at the first sample after they are gone or
+/// have migrated to another loop, whose sampler takes them over.
+/// Loop-confined: created, used and destroyed in the loop thread.
+class TcpInfoSampler : noncopyable
+{
+ public:
+  typedef std::function<void (const TcpConnectionPtr&, const TcpStats&)> SampleCallback;
+  typedef std::map<EventLoop*, std::weak_ptr<TcpInfoSampler>> LoopSamplers;
+
+  /// Aggregates of one pass.
+  struct Summary
+  {
+    Summary()
+      : connections(0), retransmits(0), rttUsSum(0), maxRttUs(0), notSentBytes(0)
+    { }
+
+    int64_t connections;   // sampled
+    int64_t retransmits;   // since the previous sample of each connection
+    int64_t rttUsSum;      // mean rtt is rttUsSum / connections
+    uint32_t maxRttUs;
+    int64_t notSentBytes;
+    Timestamp completed;
+  };
+
+  static const int kDefaultSlices = 10;
+
+  TcpInfoSampler(EventLoop* loop, double intervalSeconds, int slices = kDefaultSlices);
+  ~TcpInfoSampler();
+
+  /// Called with every sample, in the loop thread.
+  void setSampleCallback(const SampleCallback& cb)
+  { sampleCallback_ = cb; }
+
+  /// Samples @c conn from the next pass on, till it is destroyed or
+  /// migrates. @c conn must be in our loop.
+  void add(const TcpConnectionPtr& conn);
+
+  size_t size() const { return entries_.size(); }
+  /// The last completed pass.
+  const Summary& lastPass() const { return lastPass_; }
+
+ private:
+  struct Entry
+  {
+    std::weak_ptr<TcpConnection> conn;
+    int64_t migrations;  // at add(), stale once it changes
+    uint32_t totalRetrans;
+  };
+
+  void sampleSlice();
+
+  EventLoop* loop_;
+  const int slices_;
+  SampleCallback sampleCallback_;
+  std::vector<Entry> entries_;
+  size_t cursor_;    // next entry of this pass
+  int slice_;        // of this pass
+  Summary current_;
+  Summary lastPass_;
+  TimerId timer_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_TCPINFOSAMPLER_H
@@ -2,11 +2,19 @@
 #define MUDUO_NET_TCPSERVER_H
 
 #include <muduo/base/Atomic.h>
+#include <muduo/base/Mutex.h>
 #include <muduo/base/Types.h>
+#include <muduo/net/AdmissionControl.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/OpenHashMap.h>
+#include <muduo/net/RateLimiter.h>
+#include <muduo/net/SocketProfile.h>
 #include <muduo/net/TcpConnection.h>
+#include <muduo/net/TcpInfoSampler.h>
 
 #include "noncopyable.h"
 #include <map>
+#include <vector>
 #include<unordered_map>
 
 namespace muduo
@@ -24,13 +32,22 @@ class EventLoopThreadPool;
 class TcpServer : noncopyable
 {
  public:
-  typedef std::map<string, TcpConnectionPtr> ConnectionMap;
+  /// keyed by TcpConnection::id()
+  typedef OpenHashMap<TcpConnectionPtr> ConnectionMap;
 
   typedef std::function<void(EventLoop*)> ThreadInitCallback;
   enum Option
   {
     kNoReusePort,
     kReusePort,
+    /// Every I/O loop owns a SO_REUSEPORT listening socket and accepts
+    /// into itself, no hop through the base loop. A unix domain socket
+    /// path binds only once, so it gets kExclusiveListenerPerLoop.
+    kReusePortPerLoop,
+    /// One listening socket, watched with EPOLLEXCLUSIVE by every I/O
+    /// loop, whichever loop is woken accepts into itself. Keeps a single
+    /// kernel accept queue, unlike kReusePortPerLoop.
+    kExclusiveListenerPerLoop,
   };
 
   //TcpServer(EventLoop* loop, const InetAddress& listenAddr);
@@ -57,6 +74,70 @@ class TcpServer : noncopyable
   void setThreadNum(int numThreads);
   void setThreadInitCallback(const ThreadInitCallback& cb)
   { threadInitCallback_ = cb; }
+
+  /// Steer each connection to the listening socket of the I/O loop
+  /// on the CPU its SYN arrived on (cpu % numLoops), for kReusePortPerLoop.
+  ///
+  /// Assumes the N-th I/O loop thread is pinned to CPU N, e.g. by the
+  /// ThreadInitCallback. Uses SO_ATTACH_REUSEPORT_CBPF, or falls back
+  /// to SO_INCOMING_CPU if the kernel refuses the program.
+  /// Must be called before @c start
+  void setReusePortCpuSteering(bool on)
+  { cpuSteering_ = on; }
+
+  /// Accept up to @c batch pending connections per readiness notification,
+  /// the default is Acceptor::kDefaultAcceptBatch.
+  /// Must be called before @c start
+  void setAcceptBatch(int batch)
+  { acceptBatch_ = batch; }
+
+  /// Socket options for the listening sockets and every accepted
+  /// connection, see SocketProfile. The default only turns on keepalive.
+  /// Must be called before @c start
+  void setSocketProfile(const SocketProfile& profile)
+  { profile_ = profile; }
+
+  /// Edge-triggered epoll for every connection,
+  /// see TcpConnection::setEdgeTriggered().
+  /// Must be called before @c start
+  void setEdgeTriggered(bool on)
+  { edgeTriggered_ = on; }
+
+  /// Every I/O loop keeps the connections it serves in its own table:
+  /// registration and teardown run in that loop, with no hop through the
+  /// base loop and no shared lock. Together with kReusePortPerLoop or
+  /// kExclusiveListenerPerLoop accepting runs there too. Only
+  /// numConnections() is kept across loops.
+  /// Must be called before @c start
+  void setPerLoopConnections(bool on)
+  { perLoopConnections_ = on; }
+
+  /// Thread safe.
+  int64_t numConnections() const
+  { return numConnections_.get(); }
+
+  /// Close new connections right after accept(2) when they would exceed
+  /// the limits in @c options, or pause accepting when loops lag behind.
+  /// Must be called before @c start
+  void setAdmissionControl(const AdmissionControl::Options& options);
+  /// Caps every connection at @c perConnection and all connections of
+  /// one I/O loop together at @c perLoop, see TcpConnection::setRateLimit().
+  /// Must be called before @c start
+  void setRateLimit(const RateLimit& perConnection,
+                    const RateLimit& perLoop = RateLimit());
+
+  /// Reads TCP_INFO of every connection once per @c intervalSeconds,
+  /// spread over the interval, with one TcpInfoSampler per I/O loop.
+  /// @c cb is called in the connection's loop with each sample.
+  /// Must be called before @c start
+  void setTcpInfoSampling(double intervalSeconds,
+                          const TcpInfoSampler::SampleCallback& cb);
+  /// NULL without setTcpInfoSampling() or before start()
+  const TcpInfoSampler* tcpInfoSampler(EventLoop* ioLoop) const;
+
+  /// NULL without setAdmissionControl()
+  const AdmissionControl* admissionControl() const
+  { return admission_.get(); }
   /// valid after calling start()
   std::shared_ptr<EventLoopThreadPool> threadPool()
   { return threadPool_; }
@@ -85,25 +166,73 @@ class TcpServer : noncopyable
  private:
   /// Not thread safe, but in loop
   void newConnection(int sockfd, const InetAddress& peerAddr);
+  /// Not thread safe, but in acceptor's loop, for kReusePortPerLoop
+  void newConnectionInLoop(Acceptor* acceptor, int sockfd, const InetAddress& peerAddr);
+  /// NULL if refused by admission control
+  TcpConnectionPtr createConnection(Acceptor* acceptor, EventLoop* ioLoop,
+                                    int sockfd, const InetAddress& peerAddr);
+  /// Not thread safe, but in loop
+  void flushPendingConnections();
+  /// For setPerLoopConnections(), in the connection's loop:
+  /// adds to the loop's table, then connectEstablished().
+  void registerConnections(const std::vector<TcpConnectionPtr>& conns);
+  void registerConnection(const TcpConnectionPtr& conn);
   /// Thread safe.
   void removeConnection(const TcpConnectionPtr& conn);
   /// Not thread safe, but in loop
   void removeConnectionInLoop(const TcpConnectionPtr& conn);
+  /// For setPerLoopConnections(), in @c ownerLoop, which the connection
+  /// has left if it migrated.
+  void removeConnectionFromLoop(EventLoop* ownerLoop, const TcpConnectionPtr& conn);
+  void startLoopAcceptors();
+  void startSamplers();
+  bool perLoopAccept() const
+  { return option_ == kReusePortPerLoop || option_ == kExclusiveListenerPerLoop; }
 
 
   EventLoop* loop_;  // the acceptor loop
+  const InetAddress listenAddr_;
   const string ipPort_;
   const string name_;
-  std::unique_ptr<Acceptor> acceptor_; // avoid revealing Acceptor
+  // name_ + "-" + ipPort_, shared by the lazily formatted connection names
+  const std::shared_ptr<const string> connNamePrefix_;
+  const Option option_;
+  bool cpuSteering_;
+  int acceptBatch_;
+  SocketProfile profile_;
+  bool edgeTriggered_;
+  bool perLoopConnections_;
+  std::unique_ptr<Acceptor> acceptor_; // avoid revealing Acceptor, NULL in per-loop modes
+  std::vector<std::unique_ptr<Acceptor>> loopAcceptors_; // one per I/O loop, in per-loop modes
   std::shared_ptr<EventLoopThreadPool> threadPool_;
+  std::unique_ptr<AdmissionControl> admission_;
+  RateLimit connectionRateLimit_;
+  RateLimit loopRateLimit_;
+  // built by start() if loopRateLimit_ is limited, read-only afterwards
+  std::shared_ptr<const TcpConnection::LoopRateLimiters> loopRateLimiters_;
+  double samplingInterval_;  // 0 without sampling
+  TcpInfoSampler::SampleCallback sampleCallback_;
+  // built by start(), read-only afterwards; connection callbacks
+  // hold loopSamplers_, each sampler is destroyed in its loop
+  std::map<EventLoop*, std::shared_ptr<TcpInfoSampler>> samplers_;
+  std::shared_ptr<const TcpInfoSampler::LoopSamplers> loopSamplers_;
   ConnectionCallback connectionCallback_;
   MessageCallback messageCallback_;
   WriteCompleteCallback writeCompleteCallback_;
   ThreadInitCallback threadInitCallback_;
   AtomicInt32 started_;
-  // always in loop thread
-  int nextConnId_;
-  ConnectionMap connections_;
+  AtomicInt64 nextConnId_;
+  mutable AtomicInt64 numConnections_;
+  // always in loop thread, except in per-loop modes where any I/O loop
+  // may insert or erase; mutex_ is uncontended in the common case.
+  // Unused with setPerLoopConnections().
+  mutable MutexLock mutex_;
+  ConnectionMap connections_; // @GuardedBy mutex_
+  // with setPerLoopConnections(), built by start(); each table is
+  // touched only in its own loop.
+  std::map<EventLoop*, std::unique_ptr<ConnectionMap>> loopConnections_;
+  // accepted in the current batch, handed to I/O loops by flushPendingConnections()
+  std::vector<TcpConnectionPtr> pendingConnections_;
 };
 
 }
@@ -0,0 +1,37 @@
+#ifndef MUDUO_NET_TCPSTATS_H
+#define MUDUO_NET_TCPSTATS_H
+
+#include <stdint.h>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Numbers from the kernel's TCP_INFO of a connection.
+///
+/// Fields the running kernel does not report are 0.
+struct TcpStats
+{
+  uint32_t rttUs;         // smoothed round trip time
+  uint32_t rttVarUs;
+  uint32_t minRttUs;
+  uint32_t rtoUs;         // retransmission timeout
+  uint32_t sndMss;
+  uint32_t sndCwnd;       // congestion window, in segments
+  uint32_t sndSsthresh;
+  uint32_t unacked;       // segments in flight
+  uint32_t lost;          // segments presumed lost
+  uint32_t retrans;       // retransmitted segments in flight
+  uint32_t totalRetrans;  // over the lifetime of the connection
+  uint32_t notSentBytes;  // queued in the kernel, not sent yet
+  uint64_t deliveryRate;  // bytes per second
+  uint64_t bytesAcked;
+  uint64_t bytesReceived;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_TCPSTATS_H
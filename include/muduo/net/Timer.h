@@ -5,24 +5,48 @@
 #include "noncopyable.h"
 #include<functional>
 
+#include <stdint.h>
+
 namespace muduo
 {
 namespace net
 {
 //只是对定时器的抽象，比如设置当前定时器到时时要调用的回调函数cb，到期时间，是否重复等
+//Timer对象由TimerQueue的对象池分配并反复使用，generation每回收一次加一，TimerId靠它识别过期的id
 class Timer : noncopyable
 {
 public:
     typedef std::function<void()> TimerCallback;
  public:
-  Timer(TimerCallback cb, Timestamp when, double interval)
-    : callback_(std::move(cb)),
-      expiration_(when),
-      interval_(interval),
-      repeat_(interval > 0.0),
-      sequence_(s_numCreated_.incrementAndGet())
+  explicit Timer(int slot)
+    : interval_(0.0),
+      repeat_(false),
+      sequence_(0),
+      slot_(slot),
+      generation_(0),
+      canceled_(false),
+      bucket_(-1),
+      position_(0)
   { }
 
+  /// Takes a free Timer into use.
+  void init(TimerCallback cb, Timestamp when, double interval)
+  {
+    callback_ = std::move(cb);
+    expiration_ = when;
+    interval_ = interval;
+    repeat_ = interval > 0.0;
+    sequence_ = s_numCreated_.incrementAndGet();
+    canceled_ = false;
+  }
+
+  /// Gives it back to the pool, TimerIds of this use become stale.
+  void release()
+  {
+    callback_ = TimerCallback();
+    ++generation_;
+  }
+
   void run() const
   {
     callback_();
@@ -31,17 +55,38 @@ public:
   Timestamp expiration() const  { return expiration_; }
   bool repeat() const { return repeat_; }
   int64_t sequence() const { return sequence_; }
+  int slot() const { return slot_; }
+  uint32_t generation() const { return generation_; }
+
+  /// Canceled while not stored, i.e. running or not yet added.
+  bool canceled() const { return canceled_; }
+  void setCanceled() { canceled_ = true; }
 
   void restart(Timestamp now);
 
+  /// Where TimerQueue's storage keeps this timer, for O(1) removal.
+  /// bucket < 0 if not stored.
+  int bucket() const { return bucket_; }
+  size_t position() const { return position_; }
+  void setPosition(int bucket, size_t position)
+  {
+    bucket_ = bucket;
+    position_ = position;
+  }
+
   static int64_t numCreated() { return s_numCreated_.get(); }
 
  private:
-  const TimerCallback callback_;
+  TimerCallback callback_;
   Timestamp expiration_;
-  const double interval_;
-  const bool repeat_;
-  const int64_t sequence_;
+  double interval_;
+  bool repeat_;
+  int64_t sequence_;
+  const int slot_;
+  uint32_t generation_;
+  bool canceled_;
+  int bucket_;
+  size_t position_;
 
   static AtomicInt64 s_numCreated_;
 };
@@ -0,0 +1,66 @@
+#ifndef _MUDUO_NET_TIMERHEAP_H_
+#define _MUDUO_NET_TIMERHEAP_H_
+#include <muduo/base/Timestamp.h>
+#include "noncopyable.h"
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace muduo
+{
+namespace net
+{
+
+class Timer;
+
+///
+/// 4-ary min-heap of timers by expiration, default storage of TimerQueue.
+///
+/// Nodes carry the expiration next to the pointer so sifting never
+/// touches the Timer itself, and four children share a cache line.
+/// Every Timer knows its index, erase is O(log n) without a lookup.
+/// Not thread safe, owned by TimerQueue in the loop thread.
+class TimerHeap : noncopyable
+{
+ public:
+  TimerHeap();
+
+  size_t size() const { return heap_.size(); }
+  bool empty() const { return heap_.empty(); }
+
+  void insert(Timer* timer);
+  /// @return false if @c timer is not in the heap.
+  bool erase(Timer* timer);
+
+  /// Invalid if empty.
+  Timestamp earliest() const
+  { return heap_.empty() ? Timestamp::invalid() : Timestamp(heap_[0].when); }
+
+  /// Removes timers expired by @c now, appending them to @c expired.
+  void popExpired(Timestamp now, std::vector<Timer*>* expired);
+
+  /// Removes all timers, appending them to @c timers.
+  void takeAll(std::vector<Timer*>* timers);
+
+ private:
+  static const int kArity = 4;
+  static const int kBucket = 0;  // Timer::bucket() of a timer in the heap
+
+  struct Node
+  {
+    int64_t when;
+    Timer* timer;
+  };
+
+  void removeAt(size_t index);
+  void siftUp(size_t index, Node node);
+  void siftDown(size_t index, Node node);
+  void place(size_t index, const Node& node);
+
+  std::vector<Node> heap_;
+};
+
+}
+}
+#endif
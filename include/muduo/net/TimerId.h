@@ -2,31 +2,32 @@
 #define _MUDUO_NET_TIMERID_H_
 #include <muduo/base/copyable.h>
 
-#include<memory>
-#include<cstdlib>
+#include <stdint.h>
 
 namespace muduo
 {
 namespace net
 {
 
-class Timer;
-
 ///
 /// An opaque identifier, for canceling Timer.
 ///
+/// Slot of the Timer in its TimerQueue plus the generation of that slot,
+/// so canceling a timer which already fired is a harmless no-op even
+/// after the slot is reused.
+///
 class TimerId : public muduo::copyable
 {
  public:
   TimerId()
-    : timer_(NULL),
-      sequence_(0)
+    : slot_(-1),
+      generation_(0)
   {
   }
 
-  TimerId(std::shared_ptr<Timer> timer, int64_t seq)
-    : timer_(timer),
-      sequence_(seq)
+  TimerId(int slot, uint32_t generation)
+    : slot_(slot),
+      generation_(generation)
   {
   }
 
@@ -35,8 +36,8 @@ class TimerId : public muduo::copyable
   friend class TimerQueue;
 
  private:
-  std::shared_ptr<Timer> timer_;
-  int64_t sequence_;
+  int slot_;
+  uint32_t generation_;
 };
 
 }
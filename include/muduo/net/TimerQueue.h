@@ -1,11 +1,12 @@
 #ifndef _MUDUO_NET_TIMERQUEUE_H_
 #define _MUDUO_NET_TIMERQUEUE_H_
-#include <set>
+#include <memory>
 #include <vector>
 
 #include <muduo/base/Mutex.h>
 #include <muduo/base/Timestamp.h>
 #include <muduo/net/Channel.h>
+#include <muduo/net/TimerHeap.h>
 
 namespace muduo
 {
@@ -15,39 +16,59 @@ namespace net
 class EventLoop;
 class Timer;
 class TimerId;
+class TimingWheel;
 //定时器管理类，持有并管理所有Timer
+//Timer对象来自本TimerQueue的对象池：按块分配、地址不变、用完回收到空闲链表，添加定时器不再new
 class TimerQueue : noncopyable{
 private:
-    //FIX muduo 1.0 version，使用了智能指针shared_ptr取代了裸指针，避免了在析构函数中手动delete
-    typedef std::pair<Timestamp, std::shared_ptr<Timer>> Entry;
-    typedef std::set<Entry> TimerList;
-    typedef std::pair<std::shared_ptr<Timer>, int64_t> ActiveTimer;
-    typedef std::set<ActiveTimer> ActiveTimerSet;
     typedef std::function<void()> TimerCallback;
 
-    EventLoop* loop_;//所属的EventLoop
-    const int timerfd_;
-    Channel timerfdChannel_;
-    // Timer list sorted by expiration
-    TimerList timers_;
+    static const int kChunkBits = 10;
+    static const int kChunkSize = 1 << kChunkBits;//每块1024个Timer
+    static const int kMaxChunks = 4096;//最多4M个同时存在的Timer
 
-    // for cancel()
-    ActiveTimerSet activeTimers_;
+    EventLoop* loop_;//所属的EventLoop
+    int timerfd_;//-1表示不用timerfd，由EventLoop按最早的定时器设定poll的超时时间
+    std::unique_ptr<Channel> timerfdChannel_;//不用timerfd时为空
+    // Timers ordered by expiration
+    TimerHeap heap_;
+    // replaces heap_ when set
+    std::unique_ptr<TimingWheel> wheel_;
+    int64_t slackMicroSeconds_;//定时器允许推迟的时间，用来合并唤醒
+    Timestamp armedAt_;//timerfd当前设定的到期时间
 
     bool callingExpiredTimers_; /* atomic */
-    ActiveTimerSet cancelingTimers_;
+    std::vector<Timer*> expired_;//handleRead()的临时变量，复用其内存
+
+    //对象池，addTimer()可能在其他线程调用，所以分配与回收要上锁
+    MutexLock mutex_;
+    Timer* chunks_[kMaxChunks];//写入后不再改动，loop线程读取不需要锁
+    int numChunks_;// @GuardedBy mutex_
+    std::vector<int> freeSlots_;// @GuardedBy mutex_
 
 private:
-    void addTimerInLoop(std::shared_ptr<Timer> timer);
+    Timer* newTimer(TimerCallback cb, Timestamp when, double interval);
+    void deleteTimer(Timer* timer);
+    Timer* timerOf(int slot) const;
+
+    void openTimerfd();
+    void closeTimerfd();
+    static void dropThreadTimerSlack(bool drop);
+
+    void addTimerInLoop(Timer* timer);
     void cancelInLoop(TimerId timerId);
     //tmiefd上有可读事件时回调
     void handleRead();
+    void runExpired(Timestamp now);
     //处理并移除所有超时定时器
-    std::vector<Entry> getExpired(Timestamp now);
+    void getExpired(Timestamp now, std::vector<Timer*>* expired);
 
-    void reset(const std::vector<Entry>& expired, Timestamp now);
+    void reset(const std::vector<Timer*>& expired, Timestamp now);
 
-    bool insert(std::shared_ptr<Timer> timer);
+    bool insert(Timer* timer);
+    Timestamp earliest() const;
+    void armTimerfd(Timestamp earliest);
+    bool needsRearm(Timestamp when) const;
 
 public:
     explicit TimerQueue(EventLoop* loop);
@@ -58,6 +79,32 @@ public:
 
     void cancel(TimerId timerId);//移除定时器
 
+    /// Keeps timers in a TimingWheel ticking every @c tickMicroSeconds
+    /// instead of the heap, 0 goes back to the heap.
+    /// Pending timers are moved over. Must be called in the loop thread.
+    /// The MUDUO_TIMER_WHEEL_TICK_MS environment variable selects the
+    /// wheel for every TimerQueue.
+    void setTimingWheel(int64_t tickMicroSeconds);
+
+    /// Lets timers fire up to @c slackMicroSeconds late, like Linux
+    /// timer slack. timerfd is armed at the earliest expiration plus the
+    /// slack, so timers due within that window share one wakeup, and it
+    /// is not reprogrammed for a new timer whose window covers the
+    /// current arming. Must be called in the loop thread.
+    void setSlack(int64_t slackMicroSeconds);
+
+    /// Drops the timerfd: EventLoop::loop() sizes its poll timeout with
+    /// pollTimeout() and calls processTimers() after handling I/O.
+    /// false goes back to the timerfd. Pending timers stay as they are.
+    /// In the loop thread, not from a timer callback. The default is on
+    /// when the MUDUO_TIMER_POLL_TIMEOUT environment variable is set.
+    void setPollTimeout(bool on);
+    bool usesTimerfd() const { return timerfd_ >= 0; }
+    /// Microseconds till the next timer is due, at most @c maxMicroSeconds.
+    int64_t pollTimeout(Timestamp now, int64_t maxMicroSeconds) const;
+    /// Runs the timers expired by @c now.
+    void processTimers(Timestamp now);
+
 };
 }
 }
@@ -0,0 +1,76 @@
+#ifndef _MUDUO_NET_TIMINGWHEEL_H_
+#define _MUDUO_NET_TIMINGWHEEL_H_
+#include <muduo/base/Timestamp.h>
+#include "noncopyable.h"
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace muduo
+{
+namespace net
+{
+
+class Timer;
+
+///
+/// Hashed hierarchical timing wheel, alternative timer storage of TimerQueue.
+///
+/// kLevels wheels of kSlotsPerLevel slots, level l spans 64^(l+1) ticks.
+/// A timer goes into the coarsest level needed to hold it and cascades
+/// down level by level as the wheel turns. Insert and erase are O(1):
+/// every slot is a vector and a Timer remembers where it sits.
+/// Timers fire on the first tick at or after their expiration, so up to
+/// one tick late, never early.
+/// Holds Timer pointers only, TimerQueue owns the timers.
+/// Not thread safe, owned by TimerQueue in the loop thread.
+class TimingWheel : noncopyable
+{
+ public:
+  TimingWheel(int64_t tickMicroSeconds, Timestamp now);
+  ~TimingWheel();
+
+  int64_t tickMicroSeconds() const { return tickMicroSeconds_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  void insert(Timer* timer);
+  /// @return false if @c timer is not in the wheel.
+  bool erase(Timer* timer);
+
+  /// Moves an empty wheel to @c now at once, advance() is only called
+  /// while timers are pending.
+  void skipTo(Timestamp now);
+
+  /// Turns the wheel to @c now, appends timers due by then to @c expired.
+  void advance(Timestamp now, std::vector<Timer*>* expired);
+
+  /// When advance() has work next: a slot of due timers or a cascade.
+  /// Invalid if empty.
+  Timestamp nextWakeup() const;
+
+  /// Removes all timers, appending them to @c timers.
+  void takeAll(std::vector<Timer*>* timers);
+
+ private:
+  static const int kLevelBits = 6;
+  static const int kSlotsPerLevel = 1 << kLevelBits;
+  static const int kLevels = 6;
+
+  int64_t tickOf(Timestamp when) const;
+  int64_t nextTick() const;
+  void place(Timer* timer, int64_t tick);
+  void cascade(int level, int index);
+  void clearPosition(Timer* timer);
+
+  const int64_t tickMicroSeconds_;
+  int64_t current_;   // last tick processed
+  size_t size_;
+  uint64_t occupied_[kLevels];  // bit i set if slot i of that level is not empty
+  std::vector<Timer*> slots_[kLevels * kSlotsPerLevel];
+};
+
+}
+}
+#endif
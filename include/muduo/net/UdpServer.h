@@ -0,0 +1,77 @@
+#ifndef MUDUO_NET_UDPSERVER_H
+#define MUDUO_NET_UDPSERVER_H
+
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Types.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/UdpSocket.h>
+
+#include "noncopyable.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class EventLoopThreadPool;
+
+/// UDP server, a batching UdpSocket per I/O loop.
+///
+/// With threads every I/O loop binds its own SO_REUSEPORT socket to the
+/// listen address, the kernel spreads datagrams by flow and each loop
+/// reads and replies on its own socket.
+class UdpServer : noncopyable
+{
+ public:
+  typedef std::function<void(EventLoop*)> ThreadInitCallback;
+
+  UdpServer(EventLoop* loop,
+            const InetAddress& listenAddr,
+            const string& nameArg,
+            const UdpSocket::Options& options = UdpSocket::Options());
+  ~UdpServer();  // force out-line dtor, for std::unique_ptr members.
+
+  const string& name() const { return name_; }
+  EventLoop* getLoop() const { return loop_; }
+
+  /// Set the number of I/O threads, before @c start.
+  /// - 0 means one socket in loop's thread, the default.
+  /// - N means N threads with a socket each, loop's thread reads nothing.
+  void setThreadNum(int numThreads);
+  void setThreadInitCallback(const ThreadInitCallback& cb)
+  { threadInitCallback_ = cb; }
+
+  /// Called in the loop thread of the socket with each batch read.
+  /// Not thread safe, set before @c start.
+  void setMessageCallback(const UdpMessageCallback& cb)
+  { messageCallback_ = cb; }
+
+  /// Binds the sockets and starts reading. Harmless to call it multiple times.
+  /// Must be called in loop's thread.
+  void start();
+
+  /// The sockets in I/O loop order, after @c start.
+  const std::vector<std::unique_ptr<UdpSocket>>& sockets() const
+  { return sockets_; }
+
+ private:
+  EventLoop* loop_;  // the acceptor loop
+  const InetAddress listenAddr_;
+  const string name_;
+  UdpSocket::Options options_;
+  std::unique_ptr<EventLoopThreadPool> threadPool_;
+  ThreadInitCallback threadInitCallback_;
+  UdpMessageCallback messageCallback_;
+  AtomicInt32 started_;
+  std::vector<std::unique_ptr<UdpSocket>> sockets_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_UDPSERVER_H
@@ -0,0 +1,137 @@
+#ifndef MUDUO_NET_UDPSOCKET_H
+#define MUDUO_NET_UDPSOCKET_H
+
+#include <muduo/net/Callbacks.h>
+#include <muduo/net/Channel.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/Socket.h>
+
+#include "noncopyable.h"
+
+#include <vector>
+
+#include <sys/socket.h>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+
+///
+/// A datagram received, or one to send.
+///
+struct UdpMessage
+{
+  const char* data;
+  size_t length;
+  InetAddress peer;
+  /// Non-zero when GRO merged several datagrams of this size back to
+  /// back into data, the last one may be shorter.
+  uint16_t segmentSize;
+};
+
+///
+/// Bound non-blocking UDP socket on an EventLoop, reading and writing
+/// datagrams in batches.
+///
+/// A readable event is drained with recvmmsg(2), up to batchSize
+/// datagrams a call, each batch is handed to the message callback at
+/// once. send() takes a batch to one sendmmsg(2), sendSegmented()
+/// lets the kernel cut a large payload with UDP_SEGMENT (GSO).
+/// IPv4 only. Loop-confined: construct, send and destroy in the loop thread.
+class UdpSocket : noncopyable
+{
+ public:
+  struct Options
+  {
+    Options()
+      : batchSize(64),
+        bufferSize(2048),
+        maxBatchesPerRead(16),
+        gro(false),
+        reusePort(false)
+    { }
+
+    int batchSize;          // datagrams per recvmmsg(2)
+    size_t bufferSize;      // per datagram, longer ones are truncated and dropped
+    int maxBatchesPerRead;  // then back to the loop, level triggered
+    bool gro;               // UDP_GRO, buffers grow to 64KiB
+    bool reusePort;
+  };
+
+  UdpSocket(EventLoop* loop, const InetAddress& bindAddr,
+            const Options& options = Options());
+  ~UdpSocket();
+
+  EventLoop* getLoop() const { return loop_; }
+  int fd() const { return socket_.fd(); }
+  /// The port the kernel picked when bound to port 0.
+  InetAddress localAddress() const;
+
+  void setMessageCallback(const UdpMessageCallback& cb)
+  { messageCallback_ = cb; }
+
+  /// Starts reading.
+  void start();
+
+  /// Sends @c count datagrams with sendmmsg(2).
+  /// @return how many were sent, the rest is dropped when the socket
+  /// buffer is full.
+  size_t send(const UdpMessage* messages, size_t count);
+  bool send(const char* data, size_t length, const InetAddress& peer);
+
+  /// Sends @c data as datagrams of @c segmentSize bytes, the last one
+  /// may be shorter, in one syscall per 64 of them with UDP_SEGMENT.
+  /// Falls back to sendmmsg(2) if the kernel lacks GSO.
+  /// @return false if not all were sent.
+  bool sendSegmented(const char* data, size_t length, uint16_t segmentSize,
+                     const InetAddress& peer);
+
+  bool groEnabled() const { return gro_; }
+  bool gsoSupported() const { return gso_; }
+
+  int64_t numReceived() const { return numReceived_; }
+  int64_t numBatches() const { return numBatches_; }
+  int64_t numTruncated() const { return numTruncated_; }
+  int64_t numSendDropped() const { return numSendDropped_; }
+
+ private:
+  void handleRead(Timestamp receiveTime);
+  int receiveBatch();
+  size_t sendBatch(struct mmsghdr* hdrs, size_t count);
+  bool sendGso(const char* data, size_t length, uint16_t segmentSize,
+               const struct sockaddr_in& peer);
+
+  EventLoop* loop_;
+  const Options options_;
+  Socket socket_;
+  Channel channel_;
+  bool gro_;
+  bool gso_;
+  UdpMessageCallback messageCallback_;
+
+  // recvmmsg(2) state, slot i receives into buffer_ + i * bufferSize_
+  size_t bufferSize_;
+  std::vector<char> buffer_;
+  std::vector<struct mmsghdr> recvHdrs_;
+  std::vector<struct iovec> recvIovs_;
+  std::vector<struct sockaddr_in> recvAddrs_;
+  std::vector<char> recvControls_;
+  std::vector<UdpMessage> messages_;
+
+  // sendmmsg(2) scratch
+  std::vector<struct mmsghdr> sendHdrs_;
+  std::vector<struct iovec> sendIovs_;
+
+  int64_t numReceived_;
+  int64_t numBatches_;
+  int64_t numTruncated_;
+  int64_t numSendDropped_;
+};
+
+}
+}
+
+#endif  // MUDUO_NET_UDPSOCKET_H
@@ -14,24 +14,62 @@ using namespace muduo::net;
 
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport)
   : loop_(loop),
-    acceptSocket_(sockets::createNonblockingOrDie()),//创建listen fd
+    acceptSocket_(sockets::createNonblockingOrDie(listenAddr.family())),//创建listen fd
     acceptChannel_(loop, acceptSocket_.fd()),//创建listen fd对应的Channel
+    acceptBatch_(kDefaultAcceptBatch),
     listenning_(false),
+    paused_(false),
     idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))//为EMFILE错误预先准备的文件描述符
 {
   assert(idleFd_ >= 0);
-  acceptSocket_.setReuseAddr(true);
-  acceptSocket_.setReusePort(reuseport);
+  if (listenAddr.isUnix())
+  {
+    // a socket file left behind by an earlier run makes bind fail
+    string path = listenAddr.unixPath();
+    if (!path.empty() && path[0] != '@')
+    {
+      unlinkPath_ = path;
+      ::unlink(path.c_str());
+    }
+  }
+  else
+  {
+    acceptSocket_.setReuseAddr(true);
+    acceptSocket_.setReusePort(reuseport);
+  }
   acceptSocket_.bindAddress(listenAddr);
   acceptChannel_.setReadCallback(
       std::bind(&Acceptor::handleRead, this));//当acceptChannel可读时回调Acceptor::handleRead成员函数
 }
 
+Acceptor::Acceptor(EventLoop* loop, int sharedListenFd)
+  : loop_(loop),
+    acceptSocket_(::fcntl(sharedListenFd, F_DUPFD_CLOEXEC, 0)),//同一个监听socket的另一个fd，各自注册到自己的epoll
+    acceptChannel_(loop, acceptSocket_.fd()),
+    acceptBatch_(kDefaultAcceptBatch),
+    listenning_(false),
+    paused_(false),
+    idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+{
+  if (acceptSocket_.fd() < 0)
+  {
+    LOG_SYSFATAL << "Acceptor::Acceptor dup listen fd " << sharedListenFd;
+  }
+  assert(idleFd_ >= 0);
+  acceptChannel_.setReadCallback(
+      std::bind(&Acceptor::handleRead, this));
+}
+
 Acceptor::~Acceptor()
 {
+  loop_->cancel(resumeTimer_);
   acceptChannel_.disableAll();
   acceptChannel_.remove();
   ::close(idleFd_);//RAII:在析构函数里关闭这个对象所持有的文件描述符
+  if (!unlinkPath_.empty())
+  {
+    ::unlink(unlinkPath_.c_str());
+  }
 }
 
 void Acceptor::listen()
@@ -41,38 +79,90 @@ void Acceptor::listen()
   acceptSocket_.listen();
   acceptChannel_.enableReading();//往Poller里注册监听acceptChannel_的可读事件，也就是新连接建立
 }
+void Acceptor::pause()
+{
+  loop_->assertInLoopThread();
+  if (listenning_ && !paused_)
+  {
+    paused_ = true;
+    acceptChannel_.disableReading();
+  }
+}
+
+void Acceptor::resume()
+{
+  loop_->assertInLoopThread();
+  if (listenning_ && paused_)
+  {
+    paused_ = false;
+    acceptChannel_.enableReading();
+  }
+}
+
+void Acceptor::pauseFor(double seconds)
+{
+  loop_->assertInLoopThread();
+  if (listenning_ && !paused_)
+  {
+    pause();
+    resumeTimer_ = loop_->runAfter(seconds, std::bind(&Acceptor::resume, this));
+  }
+}
+
 /****aceptChannel_可读时会回调的函数:
- * 1.accept新连接得到一个已连接文件描述符cfd;
- * 2.回调TCPServer注册给他的回调函数:newConnectionCallback_,在这个回调函数里new TCPConnection并且注册监听cfd的可读事件
+ * 1.循环accept新连接得到已连接文件描述符cfd,直到EAGAIN、达到acceptBatch_个或者被暂停;
+ * 2.每个cfd回调TCPServer注册给他的回调函数:newConnectionCallback_,在这个回调函数里new TCPConnection
+ * 3.整批结束后回调acceptBatchCallback_,由TcpServer把这一批连接一次性交给各个IO线程
  * ************/
 void Acceptor::handleRead()
 {
   loop_->assertInLoopThread();
-  InetAddress peerAddr;
-  int connfd = acceptSocket_.accept(&peerAddr);
-  if (connfd >= 0)
+  int accepted = 0;
+  // 回调里pauseFor()暂停后立即停止,剩下的连接留在内核backlog里
+  for (int i = 0; i < acceptBatch_ && !paused_; ++i)
   {
-    if (newConnectionCallback_)
+    InetAddress peerAddr;
+    int connfd = acceptSocket_.accept(&peerAddr);
+    if (connfd >= 0)
     {
-      newConnectionCallback_(connfd, peerAddr);
+      ++accepted;
+      if (newConnectionCallback_)
+      {
+        newConnectionCallback_(connfd, peerAddr);
+      }
+      else
+      {
+        sockets::close(connfd);
+      }
     }
     else
     {
-      sockets::close(connfd);
+      int savedErrno = errno;
+      if (savedErrno == EAGAIN)
+      {
+        break;  // backlog drained
+      }
+      else if (savedErrno == ECONNABORTED || savedErrno == EINTR)
+      {
+        continue;
+      }
+      LOG_SYSERR << "in Acceptor::handleRead";
+      // Read the section named "The special problem of
+      // accept()ing when you can't" in libev's doc.
+      // By Marc Lehmann, author of libev.
+      if (savedErrno == EMFILE)//----------处理EMFILE错误
+      {
+        ::close(idleFd_);
+        idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
+        ::close(idleFd_);
+        idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+      }
+      break;
     }
   }
-  else
+
+  if (accepted > 0 && acceptBatchCallback_)
   {
-    LOG_SYSERR << "in Acceptor::handleRead";
-    // Read the section named "The special problem of
-    // accept()ing when you can't" in libev's doc.
-    // By Marc Lehmann, author of libev.
-    if (errno == EMFILE)//----------处理EMFILE错误
-    {
-      ::close(idleFd_);
-      idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
-      ::close(idleFd_);
-      idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
-    }
+    acceptBatchCallback_();
   }
 }
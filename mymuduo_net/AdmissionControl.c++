@@ -0,0 +1,79 @@
+#include <muduo/net/AdmissionControl.h>
+
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+bool limitsPerIp(const AdmissionControl::Options& options, const InetAddress& addr)
+{
+  return options.maxConnectionsPerIp > 0
+      && addr.family() == AF_INET
+      && addr.ipNetEndian() != 0;
+}
+
+}
+
+AdmissionControl::AdmissionControl(const Options& options)
+  : options_(options)
+{
+}
+
+AdmissionControl::Verdict AdmissionControl::admit(const InetAddress& peerAddr,
+                                                  const EventLoop* ioLoop)
+{
+  Verdict verdict = kAdmit;
+  if (options_.maxLoopLagSeconds > 0.0 && ioLoop != NULL
+      && ioLoop->lagMicroSeconds() >
+         static_cast<int64_t>(options_.maxLoopLagSeconds * Timestamp::kMicroSecondsPerSecond))
+  {
+    verdict = kRejectLoopLag;
+  }
+  else if (options_.maxConnections > 0
+           && numConnections_.incrementAndGet() > options_.maxConnections)
+  {
+    numConnections_.decrement();
+    verdict = kRejectMaxConnections;
+  }
+  else
+  {
+    if (options_.maxConnections <= 0)
+    {
+      numConnections_.increment();
+    }
+    if (limitsPerIp(options_, peerAddr))
+    {
+      MutexLockGuard lock(mutex_);
+      int& count = perIp_[peerAddr.ipNetEndian()];
+      if (count >= options_.maxConnectionsPerIp)
+      {
+        numConnections_.decrement();
+        verdict = kRejectPerIp;
+      }
+      else
+      {
+        ++count;
+      }
+    }
+  }
+  verdicts_[verdict].increment();
+  return verdict;
+}
+
+void AdmissionControl::release(const InetAddress& peerAddr)
+{
+  numConnections_.decrement();
+  if (limitsPerIp(options_, peerAddr))
+  {
+    MutexLockGuard lock(mutex_);
+    int* count = perIp_.find(peerAddr.ipNetEndian());
+    if (count != NULL && --*count <= 0)
+    {
+      perIp_.erase(peerAddr.ipNetEndian());
+    }
+  }
+}
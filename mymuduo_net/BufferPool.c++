@@ -0,0 +1,91 @@
+#include <muduo/net/BufferPool.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/Buffer.h>
+#include <muduo/net/EventLoop.h>
+
+#include <algorithm>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t BufferPool::kShrinkRatio;
+
+BufferPool::BufferPool(EventLoop* loop, const Options& options)
+  : loop_(CHECK_NOTNULL(loop)),
+    options_(options),
+    minFree_(0),
+    numCreated_(0),
+    numShrunk_(0),
+    trimming_(false)
+{
+}
+
+BufferPool::~BufferPool()
+{
+  if (trimming_)
+  {
+    loop_->cancel(trimTimer_);
+  }
+}
+
+std::unique_ptr<Buffer> BufferPool::get()
+{
+  loop_->assertInLoopThread();
+  if (!trimming_ && options_.trimIntervalSeconds > 0.0)
+  {
+    trimming_ = true;
+    trimTimer_ = loop_->runEvery(options_.trimIntervalSeconds,
+                                 std::bind(&BufferPool::trim, this));
+  }
+  if (free_.empty())
+  {
+    ++numCreated_;
+    return std::unique_ptr<Buffer>(new Buffer);
+  }
+  std::unique_ptr<Buffer> buf(std::move(free_.back()));
+  free_.pop_back();
+  minFree_ = std::min(minFree_, free_.size());
+  return buf;
+}
+
+void BufferPool::put(std::unique_ptr<Buffer> buf)
+{
+  loop_->assertInLoopThread();
+  assert(buf->readableBytes() == 0);
+  if (buf->internalCapacity() <= options_.maxPooledCapacity)
+  {
+    buf->retrieveAll();  // back to the front, all of it writable
+    free_.push_back(std::move(buf));
+  }
+}
+
+// Called wherever a connection consumes bytes, so the last call before
+// a connection goes idle leaves its buffer no larger than needed.
+void BufferPool::reclaim(std::unique_ptr<Buffer>* buf)
+{
+  loop_->assertInLoopThread();
+  size_t readable = (*buf)->readableBytes();
+  size_t capacity = (*buf)->internalCapacity();
+  if (readable == 0)
+  {
+    put(std::move(*buf));
+  }
+  else if (capacity > options_.maxPooledCapacity && readable * kShrinkRatio < capacity)
+  {
+    // copies at most capacity / kShrinkRatio bytes
+    (*buf)->shrink(0);
+    ++numShrunk_;
+  }
+}
+
+// whatever stayed in the pool the whole interval was not needed
+void BufferPool::trim()
+{
+  if (minFree_ > 0)
+  {
+    LOG_DEBUG << "BufferPool::trim freeing " << minFree_ << " of " << free_.size();
+    free_.erase(free_.begin(), free_.begin() + minFree_);
+  }
+  minFree_ = free_.size();
+}
@@ -14,15 +14,34 @@ const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;//等价于POLLIN|POLLPRI，值上二者是相等的
 const int Channel::kWriteEvent = EPOLLOUT;//等价于POLLOUT
 
+// set*Callback()的回调也通过ChannelHandler分发
+struct Channel::Callbacks : public ChannelHandler
+{
+    virtual void handleRead(Timestamp receiveTime) { if (readCallback) readCallback(receiveTime); }
+    virtual void handleWrite() { if (writeCallback) writeCallback(); }
+    virtual void handleClose() { if (closeCallback) closeCallback(); }
+    virtual void handleError() { if (errorCallback) errorCallback(); }
+
+    ReadEventCallBackFunc readCallback;
+    EventCallBackFunc writeCallback;
+    EventCallBackFunc closeCallback;
+    EventCallBackFunc errorCallback;
+};
+
 Channel::Channel(EventLoop * loop,int fd):
-    loop_(loop),//当前Channel所属的evetnloop
+    handler_(NULL),
     fd_(fd),//当前Channel管理的fd
     events_(0),//当前Channel正在监听的事件
     revents_(0),//当前Channel在POller返回后的活跃事件
     index_(-1),
-    logHup_(true),
+    tied_(false),
     eventHandling_(false),//当前Channel是否正在处理事件
-    addedToLoop_(false)
+    addedToLoop_(false),
+    exclusive_(false),
+    edgeTriggered_(false),
+    edgeArmed_(false),
+    logHup_(true),
+    loop_(loop)//当前Channel所属的evetnloop
 {
 
 }
@@ -31,34 +50,143 @@ Channel::~Channel()//因为Channel不拥有fd或者其他资源，因此析构
 
 }
 
+Channel::Callbacks& Channel::callbacks()
+{
+    if (!callbacks_)
+    {
+        callbacks_.reset(new Callbacks);
+        handler_ = callbacks_.get();
+    }
+    return *callbacks_;
+}
+
+void Channel::setReadCallback(ReadEventCallBackFunc cb)
+{
+    callbacks().readCallback = std::move(cb);
+}
+
+void Channel::setWriteCallback(EventCallBackFunc cb)
+{
+    callbacks().writeCallback = std::move(cb);
+}
+
+void Channel::setCloseCallback(EventCallBackFunc cb)
+{
+    callbacks().closeCallback = std::move(cb);
+}
+
+void Channel::setErrorCallback(EventCallBackFunc cb)
+{
+    callbacks().errorCallback = std::move(cb);
+}
+
 void Channel::update()//将当前Channel的可读可写事件更新到他所属的EventLoop
 {
     addedToLoop_ = true;
+    edgeArmed_ = edgeTriggered_ && !isNoneEvent();
     loop_->updateChannel(this);
 }
+
+void Channel::enable(int event)
+{
+    bool wasEnabled = (events_ & event) == event;
+    events_ |= event;
+    // 边沿触发时兴趣一直在epoll里，重新打开时MOD一次，补上关闭期间错过的边沿
+    if (!edgeTriggered_ || !edgeArmed_ || !wasEnabled)
+    {
+        update();
+    }
+}
+
+void Channel::disable(int event)
+{
+    events_ &= ~event;
+    // 边沿触发时只是不再回调，不动epoll
+    if (!edgeTriggered_)
+    {
+        update();
+    }
+}
+
+void Channel::enableWritingAfterShortWrite()
+{
+    events_ |= kWriteEvent;
+    if (!edgeTriggered_ || !edgeArmed_)
+    {
+        update();
+    }
+}
+
+void Channel::rearm()
+{
+    if (edgeTriggered_ && edgeArmed_)
+    {
+        update();
+    }
+}
+
+int Channel::registered_events() const
+{
+    return edgeTriggered_ && !isNoneEvent() ? kReadEvent | kWriteEvent | EPOLLET : events_;
+}
 void Channel::remove()//将当前Channel从他所属的EventLoop中移除，EventLoop进一步调用Poller上的remove函数
 {
     addedToLoop_ = false;
+    edgeArmed_ = false;
     loop_->removeChannel(this);
 }
+void Channel::tie(const std::shared_ptr<void>& obj)
+{
+    tie_ = obj;
+    tied_ = true;
+}
+
 /**事件回调函数,被Poller的poll()所调用，用于在poll()/epoll()返回时响应活跃事件**/
-void Channel::handleEvent(Timestamp activeTime){
+void Channel::handleEvent(Timestamp activeTime)
+{
+    std::shared_ptr<void> guard;
+    if (tied_)
+    {
+        guard = tie_.lock();
+        if (guard)
+        {
+            handleEventWithGuard(activeTime);
+        }
+    }
+    else
+    {
+        handleEventWithGuard(activeTime);
+    }
+}
+
+void Channel::handleEventWithGuard(Timestamp activeTime){
     eventHandling_ = true;
+    if (edgeTriggered_)
+    {
+        // 边沿触发时epoll总是报告读写，过滤掉已关闭的兴趣
+        revents_ &= events_ | EPOLLHUP | EPOLLERR | EPOLLRDHUP;
+    }
+    if (!handler_)
+    {
+        eventHandling_ = false;
+        return;
+    }
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))//EPOLLHUP:不可读也不可写，对端close()
     {
         LOG_WARN << "fd = " << fd_ << " Channel::handle_event() POLLHUP";
-        if (closeCallback_) closeCallback_();
+        handler_->handleClose();
     }
     if (revents_ & EPOLLERR )
     {
-        if (errorCallback_) errorCallback_();
+        handler_->handleError();
     }
     if (revents_ & (EPOLLIN | EPOLLPRI | EPOLLRDHUP))//EPOLLRDHUP:不可读，对端调用close()或者shutdown(WR)
     {
-        if (readCallback_) readCallback_(activeTime);
+        handler_->handleRead(activeTime);
     }
     if (revents_ & EPOLLOUT)//可写事件满足
     {
-        if (writeCallback_) writeCallback_();
+        handler_->handleWrite();
     }
+    eventHandling_ = false;
 }
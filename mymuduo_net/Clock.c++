@@ -0,0 +1,149 @@
+#include <muduo/net/Clock.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define MUDUO_HAVE_TSC 1
+#endif
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+int64_t monotonicCoarseMicroSeconds()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond + ts.tv_nsec / 1000;
+}
+
+int64_t monotonicMicroSeconds()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond + ts.tv_nsec / 1000;
+}
+
+// wall clock minus CLOCK_MONOTONIC_COARSE, taken once
+struct CoarseAnchor
+{
+  CoarseAnchor()
+    : offset(Timestamp::now().microSecondsSinceEpoch() - monotonicCoarseMicroSeconds())
+  { }
+
+  const int64_t offset;
+};
+
+#ifdef MUDUO_HAVE_TSC
+bool hasInvariantTsc()
+{
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+  {
+    return false;
+  }
+  __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  return (edx & (1u << 8)) != 0;
+}
+
+// counts TSC ticks against CLOCK_MONOTONIC over 20ms, once per process
+struct TscAnchor
+{
+  TscAnchor()
+    : usable(hasInvariantTsc()),
+      baseTsc(0),
+      baseMicroSeconds(0),
+      microSecondsPerTick(0.0)
+  {
+    if (!usable)
+    {
+      return;
+    }
+    int64_t startUs = monotonicMicroSeconds();
+    uint64_t startTsc = __rdtsc();
+    ::usleep(20 * 1000);
+    int64_t endUs = monotonicMicroSeconds();
+    uint64_t endTsc = __rdtsc();
+    if (endTsc <= startTsc || endUs <= startUs)
+    {
+      usable = false;
+      return;
+    }
+    microSecondsPerTick = static_cast<double>(endUs - startUs)
+                          / static_cast<double>(endTsc - startTsc);
+    baseTsc = __rdtsc();
+    baseMicroSeconds = Timestamp::now().microSecondsSinceEpoch();
+  }
+
+  bool usable;
+  uint64_t baseTsc;
+  int64_t baseMicroSeconds;
+  double microSecondsPerTick;
+};
+
+const TscAnchor& tscAnchor()
+{
+  static TscAnchor anchor;
+  return anchor;
+}
+#endif
+
+}
+
+Timestamp Clock::anchoredNow(Source source)
+{
+#ifdef MUDUO_HAVE_TSC
+  if (source == kTsc)
+  {
+    const TscAnchor& anchor = tscAnchor();
+    if (anchor.usable)
+    {
+      double elapsed = static_cast<double>(static_cast<int64_t>(__rdtsc() - anchor.baseTsc))
+                     * anchor.microSecondsPerTick;
+      return Timestamp(anchor.baseMicroSeconds + static_cast<int64_t>(elapsed));
+    }
+    return Timestamp::now();
+  }
+#else
+  if (source == kTsc)
+  {
+    return Timestamp::now();
+  }
+#endif
+  static CoarseAnchor anchor;
+  return Timestamp(anchor.offset + monotonicCoarseMicroSeconds());
+}
+
+bool Clock::tscUsable()
+{
+#ifdef MUDUO_HAVE_TSC
+  return tscAnchor().usable;
+#else
+  return false;
+#endif
+}
+
+Clock::Source Clock::defaultSource()
+{
+  const char* name = ::getenv("MUDUO_CLOCK");
+  if (name == NULL)
+  {
+    return kGettimeofday;
+  }
+  if (::strcmp(name, "coarse") == 0)
+  {
+    return kMonotonicCoarse;
+  }
+  if (::strcmp(name, "tsc") == 0)
+  {
+    return kTsc;
+  }
+  return kGettimeofday;
+}
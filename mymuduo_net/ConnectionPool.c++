@@ -0,0 +1,246 @@
+#include <muduo/net/ConnectionPool.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/TcpClient.h>
+
+#include <stdio.h>  // snprintf
+
+using namespace muduo;
+using namespace muduo::net;
+
+ConnectionPool::ConnectionPool(EventLoop* loop,
+                               const std::vector<InetAddress>& backends,
+                               const string& nameArg,
+                               const Options& options)
+  : loop_(CHECK_NOTNULL(loop)),
+    name_(nameArg),
+    options_(options),
+    next_(0),
+    nextClientId_(1),
+    started_(false),
+    nextWaiterId_(1)
+{
+  assert(!backends.empty());
+  assert(options_.maxConnections > 0 && options_.minIdle <= options_.maxConnections);
+  for (const InetAddress& addr : backends)
+  {
+    backends_.push_back(Backend(addr));
+  }
+}
+
+ConnectionPool::~ConnectionPool()
+{
+  loop_->assertInLoopThread();
+  std::deque<Waiter> waiters;
+  waiters.swap(waiters_);
+  for (Waiter& waiter : waiters)
+  {
+    loop_->cancel(waiter.timer);
+    waiter.cb(TcpConnectionPtr());
+  }
+
+  // lent out connections outlive the pool, they must not call back into it
+  for (auto& item : backendOf_)
+  {
+    item.first->setConnectionCallback(defaultConnectionCallback);
+  }
+  backendOf_.clear();
+  for (Backend& backend : backends_)
+  {
+    // the close is only queued, a read may come first
+    for (const TcpConnectionPtr& conn : backend.idle)
+    {
+      conn->setMessageCallback(defaultMessageCallback);
+      conn->forceClose();
+    }
+    backend.idle.clear();
+    backend.clients.clear();
+  }
+}
+
+void ConnectionPool::start()
+{
+  loop_->assertInLoopThread();
+  assert(!started_);
+  started_ = true;
+  for (size_t i = 0; i < backends_.size(); ++i)
+  {
+    replenish(i);
+  }
+}
+
+size_t ConnectionPool::numIdle() const
+{
+  size_t n = 0;
+  for (const Backend& backend : backends_)
+  {
+    n += backend.idle.size();
+  }
+  return n;
+}
+
+void ConnectionPool::addClient(size_t index)
+{
+  Backend& backend = backends_[index];
+  char buf[64];
+  snprintf(buf, sizeof buf, "-%s#%d", backend.addr.toIpPort().c_str(), nextClientId_);
+  ++nextClientId_;
+  std::unique_ptr<TcpClient> client(new TcpClient(loop_, backend.addr, name_ + buf));
+  client->setConnectionCallback(
+      std::bind(&ConnectionPool::onConnection, this, index, _1));
+  client->setMessageCallback(&ConnectionPool::onIdleMessage);
+  client->setRetryDelay(options_.initRetryDelayMs, options_.maxRetryDelayMs);
+  client->setSocketProfile(options_.socketProfile);
+  client->enableRetry();
+  client->connect();
+  backend.clients.push_back(std::move(client));
+}
+
+// keeps minIdle connections idle or on the way
+void ConnectionPool::replenish(size_t index)
+{
+  Backend& backend = backends_[index];
+  int numClients = static_cast<int>(backend.clients.size());
+  int numConnecting = numClients - backend.numConnected;
+  int numIdle = static_cast<int>(backend.idle.size());
+  for (int n = numIdle + numConnecting;
+       n < options_.minIdle && numClients < options_.maxConnections;
+       ++n, ++numClients)
+  {
+    addClient(index);
+  }
+}
+
+// opens one more connection for a waiter, round robin over backends with room
+bool ConnectionPool::grow()
+{
+  for (size_t i = 0; i < backends_.size(); ++i)
+  {
+    size_t index = (next_ + i) % backends_.size();
+    if (static_cast<int>(backends_[index].clients.size()) < options_.maxConnections)
+    {
+      addClient(index);
+      next_ = (index + 1) % backends_.size();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ConnectionPool::checkout(const CheckoutCallback& cb)
+{
+  loop_->assertInLoopThread();
+  for (size_t i = 0; i < backends_.size(); ++i)
+  {
+    size_t index = (next_ + i) % backends_.size();
+    Backend& backend = backends_[index];
+    while (!backend.idle.empty())
+    {
+      TcpConnectionPtr conn(std::move(backend.idle.back()));
+      backend.idle.pop_back();
+      if (conn->connected())
+      {
+        next_ = (index + 1) % backends_.size();
+        replenish(index);
+        cb(conn);
+        return;
+      }
+    }
+  }
+
+  Waiter waiter;
+  waiter.id = nextWaiterId_++;
+  waiter.cb = cb;
+  waiter.timer = loop_->runAfter(options_.checkoutTimeoutSeconds,
+      std::bind(&ConnectionPool::onCheckoutTimeout, this, waiter.id));
+  waiters_.push_back(std::move(waiter));
+  if (!grow())
+  {
+    LOG_DEBUG << "ConnectionPool [" << name_ << "] full, "
+              << waiters_.size() << " waiting";
+  }
+}
+
+void ConnectionPool::checkin(const TcpConnectionPtr& conn)
+{
+  loop_->assertInLoopThread();
+  assert(conn->getLoop() == loop_);
+  if (!backendOf_.count(get_pointer(conn)))
+  {
+    return;  // closed while lent out, its TcpClient reconnects
+  }
+  conn->setMessageCallback(&ConnectionPool::onIdleMessage);
+  if (conn->inputBytes() > 0)
+  {
+    LOG_WARN << "ConnectionPool [" << name_ << "] " << conn->name()
+             << " checked in with unread input, closing";
+    conn->forceClose();
+    return;
+  }
+  lend(conn);
+}
+
+// to the first waiter, or back to idle
+void ConnectionPool::lend(const TcpConnectionPtr& conn)
+{
+  if (!waiters_.empty())
+  {
+    Waiter waiter(std::move(waiters_.front()));
+    waiters_.pop_front();
+    loop_->cancel(waiter.timer);
+    waiter.cb(conn);
+  }
+  else
+  {
+    backends_[backendOf_[get_pointer(conn)]].idle.push_back(conn);
+  }
+}
+
+void ConnectionPool::onConnection(size_t index, const TcpConnectionPtr& conn)
+{
+  loop_->assertInLoopThread();
+  Backend& backend = backends_[index];
+  if (conn->connected())
+  {
+    ++backend.numConnected;
+    backendOf_[get_pointer(conn)] = index;
+    lend(conn);
+  }
+  else
+  {
+    --backend.numConnected;
+    backendOf_.erase(get_pointer(conn));
+    for (size_t i = 0; i < backend.idle.size(); ++i)
+    {
+      if (backend.idle[i] == conn)
+      {
+        backend.idle.erase(backend.idle.begin() + i);
+        break;
+      }
+    }
+  }
+}
+
+void ConnectionPool::onIdleMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  LOG_WARN << "ConnectionPool - " << conn->name()
+           << " got " << buf->readableBytes() << " bytes while idle, closing";
+  buf->retrieveAll();
+  conn->forceClose();
+}
+
+void ConnectionPool::onCheckoutTimeout(int64_t id)
+{
+  for (auto it = waiters_.begin(); it != waiters_.end(); ++it)
+  {
+    if (it->id == id)
+    {
+      CheckoutCallback cb(std::move(it->cb));
+      waiters_.erase(it);
+      LOG_WARN << "ConnectionPool [" << name_ << "] checkout timed out";
+      cb(TcpConnectionPtr());
+      return;
+    }
+  }
+}
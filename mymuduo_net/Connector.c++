@@ -0,0 +1,220 @@
+#include <muduo/net/Connector.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/Channel.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/SocketsOps.h>
+
+#include <algorithm>
+
+#include <errno.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+Connector::Connector(EventLoop* loop, const InetAddress& serverAddr)
+  : loop_(loop),
+    serverAddr_(serverAddr),
+    connect_(false),
+    state_(kDisconnected),
+    initRetryDelayMs_(kInitRetryDelayMs),
+    maxRetryDelayMs_(kMaxRetryDelayMs),
+    retryDelayMs_(kInitRetryDelayMs)
+{
+  LOG_DEBUG << "ctor[" << this << "]";
+}
+
+Connector::~Connector()
+{
+  LOG_DEBUG << "dtor[" << this << "]";
+  assert(!channel_);
+}
+
+void Connector::start()
+{
+  connect_ = true;
+  loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+  loop_->assertInLoopThread();
+  assert(state_ == kDisconnected);
+  if (connect_)
+  {
+    connect();
+  }
+  else
+  {
+    LOG_DEBUG << "do not connect";
+  }
+}
+
+void Connector::stop()
+{
+  connect_ = false;
+  // keeps us alive till stopped, the owner may let go right away
+  loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::stopInLoop()
+{
+  loop_->assertInLoopThread();
+  loop_->cancel(retryTimer_);
+  if (state_ == kConnecting)
+  {
+    setState(kDisconnected);
+    int sockfd = removeAndResetChannel();
+    retry(sockfd);
+  }
+}
+
+void Connector::connect()
+{
+  int sockfd = sockets::createNonblockingOrDie(serverAddr_.family());
+  int ret = sockets::connect(sockfd, serverAddr_.getSockAddr(), serverAddr_.sockLen());
+  int savedErrno = (ret == 0) ? 0 : errno;
+  switch (savedErrno)
+  {
+    case 0:
+    case EINPROGRESS:
+    case EINTR:
+    case EISCONN:
+      connecting(sockfd);
+      break;
+
+    case EAGAIN:
+    case EADDRINUSE:
+    case EADDRNOTAVAIL:
+    case ECONNREFUSED:
+    case ENETUNREACH:
+    case ENOENT:  // AF_UNIX path not there yet
+      retry(sockfd);
+      break;
+
+    case EACCES:
+    case EPERM:
+    case EAFNOSUPPORT:
+    case EALREADY:
+    case EBADF:
+    case EFAULT:
+    case ENOTSOCK:
+      LOG_SYSERR << "connect error in Connector::startInLoop " << savedErrno;
+      sockets::close(sockfd);
+      break;
+
+    default:
+      LOG_SYSERR << "Unexpected error in Connector::startInLoop " << savedErrno;
+      sockets::close(sockfd);
+      // connectErrorCallback_();
+      break;
+  }
+}
+
+void Connector::restart()
+{
+  loop_->assertInLoopThread();
+  setState(kDisconnected);
+  retryDelayMs_ = initRetryDelayMs_;
+  connect_ = true;
+  startInLoop();
+}
+
+void Connector::connecting(int sockfd)
+{
+  setState(kConnecting);
+  assert(!channel_);
+  channel_.reset(new Channel(loop_, sockfd));
+  channel_->setWriteCallback(
+      std::bind(&Connector::handleWrite, this)); // FIXME: unsafe
+  channel_->setErrorCallback(
+      std::bind(&Connector::handleError, this)); // FIXME: unsafe
+
+  // channel_->tie(shared_from_this()); is not working,
+  // as channel_ is not managed by shared_ptr
+  channel_->enableWriting();
+}
+
+int Connector::removeAndResetChannel()
+{
+  channel_->disableAll();
+  channel_->remove();
+  int sockfd = channel_->fd();
+  // Can't reset channel_ here, because we are inside Channel::handleEvent
+  loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+  return sockfd;
+}
+
+void Connector::resetChannel()
+{
+  channel_.reset();
+}
+
+void Connector::handleWrite()
+{
+  LOG_TRACE << "Connector::handleWrite " << state_;
+
+  if (state_ == kConnecting)
+  {
+    int sockfd = removeAndResetChannel();
+    int err = sockets::getSocketError(sockfd);
+    if (err)
+    {
+      LOG_WARN << "Connector::handleWrite - SO_ERROR = "
+               << err << " " << strerror_tl(err);
+      retry(sockfd);
+    }
+    else if (!serverAddr_.isUnix() && sockets::isSelfConnect(sockfd))
+    {
+      LOG_WARN << "Connector::handleWrite - Self connect";
+      retry(sockfd);
+    }
+    else
+    {
+      setState(kConnected);
+      if (connect_)
+      {
+        newConnectionCallback_(sockfd);
+      }
+      else
+      {
+        sockets::close(sockfd);
+      }
+    }
+  }
+  else
+  {
+    // what happened?
+    assert(state_ == kDisconnected);
+  }
+}
+
+void Connector::handleError()
+{
+  LOG_ERROR << "Connector::handleError state=" << state_;
+  if (state_ == kConnecting)
+  {
+    int sockfd = removeAndResetChannel();
+    int err = sockets::getSocketError(sockfd);
+    LOG_TRACE << "SO_ERROR = " << err << " " << strerror_tl(err);
+    retry(sockfd);
+  }
+}
+
+void Connector::retry(int sockfd)
+{
+  sockets::close(sockfd);
+  setState(kDisconnected);
+  if (connect_)
+  {
+    LOG_INFO << "Connector::retry - Retry connecting to " << serverAddr_.toIpPort()
+             << " in " << retryDelayMs_ << " milliseconds. ";
+    retryTimer_ = loop_->runAfter(retryDelayMs_/1000.0,
+                                  std::bind(&Connector::startInLoop, shared_from_this()));
+    retryDelayMs_ = std::min(retryDelayMs_ * 2, maxRetryDelayMs_);
+  }
+  else
+  {
+    LOG_DEBUG << "do not connect";
+  }
+}
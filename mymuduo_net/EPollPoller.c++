@@ -7,8 +7,17 @@
 #include <errno.h>
 #include <poll.h>
 #include <sys/epoll.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)  // since Linux 4.5
+#endif
+
+#ifndef SYS_epoll_pwait2
+#define SYS_epoll_pwait2 441  // since Linux 5.11, same number on all architectures
+#endif
+
 using namespace muduo;
 using namespace muduo::net;
 namespace
@@ -21,7 +30,8 @@ const int kDeleted = 2;
 EPollPoller::EPollPoller(EventLoop* loop)
   : Poller(loop),
     epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
-    events_(kInitEventListSize)
+    events_(kInitEventListSize),
+    havePwait2_(true)
 {
   if (epollfd_ < 0)
   {
@@ -49,13 +59,39 @@ void EPollPoller::fillActiveChannels(int numEvents,
 /***调用等待IO事件的函数::epoll_wait()*****/
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList* activeChannels)
 {
-  LOG_TRACE << "fd total count " << channels_.size();
+  LOG_TRACE << "fd total count " << numChannels();
   int numEvents = ::epoll_wait(epollfd_,
                                events_.data(),
                                static_cast<int>(events_.size()),
                                timeoutMs);
-  int savedErrno = errno;
-  Timestamp now(Timestamp::now());
+  return afterWait(numEvents, errno, activeChannels);
+}
+
+Timestamp EPollPoller::pollMicroSeconds(int64_t timeoutUs, ChannelList* activeChannels)
+{
+  if (timeoutUs < 0 || timeoutUs % 1000 == 0 || !havePwait2_)
+  {
+    return Poller::pollMicroSeconds(timeoutUs, activeChannels);
+  }
+  struct timespec ts;
+  ts.tv_sec = static_cast<time_t>(timeoutUs / Timestamp::kMicroSecondsPerSecond);
+  ts.tv_nsec = static_cast<long>(timeoutUs % Timestamp::kMicroSecondsPerSecond * 1000);
+  // no glibc wrapper before 2.35
+  int numEvents = static_cast<int>(::syscall(SYS_epoll_pwait2, epollfd_,
+                                             events_.data(),
+                                             static_cast<int>(events_.size()),
+                                             &ts, NULL, 0));
+  if (numEvents < 0 && errno == ENOSYS)
+  {
+    havePwait2_ = false;
+    return Poller::pollMicroSeconds(timeoutUs, activeChannels);
+  }
+  return afterWait(numEvents, errno, activeChannels);
+}
+
+Timestamp EPollPoller::afterWait(int numEvents, int savedErrno, ChannelList* activeChannels)
+{
+  Timestamp now(clockNow());
   if (numEvents > 0)
   {
     LOG_TRACE << numEvents << " events happened";
@@ -93,13 +129,11 @@ void EPollPoller::updateChannel(Channel* channel)
     int fd = channel->fd();
     if (index == kNew)
     {
-      assert(channels_.find(fd) == channels_.end());
-      channels_[fd] = channel;
+      addChannelEntry(channel);
     }
     else // index == kDeleted
     {
-      assert(channels_.find(fd) != channels_.end());
-      assert(channels_[fd] == channel);
+      assert(findChannel(fd) == channel);
     }
 
     channel->set_index(kAdded);
@@ -110,8 +144,7 @@ void EPollPoller::updateChannel(Channel* channel)
     // update existing one with EPOLL_CTL_MOD/DEL
     int fd = channel->fd();
     (void)fd;
-    assert(channels_.find(fd) != channels_.end());
-    assert(channels_[fd] == channel);
+    assert(findChannel(fd) == channel);
     assert(index == kAdded);
     if (channel->isNoneEvent())
     {
@@ -129,14 +162,11 @@ void EPollPoller::removeChannel(Channel* channel)
 {
   int fd = channel->fd();
   LOG_TRACE << "fd = " << fd;
-  assert(channels_.find(fd) != channels_.end());
-  assert(channels_[fd] == channel);
+  assert(findChannel(fd) == channel);
   assert(channel->isNoneEvent());
   int index = channel->index();
   assert(index == kAdded || index == kDeleted);
-  size_t n = channels_.erase(fd);
-  (void)n;
-  assert(n == 1);
+  removeChannelEntry(channel);
 
   if (index == kAdded)
   {
@@ -149,7 +179,13 @@ void EPollPoller::update(int operation, Channel* channel)
 {
   struct epoll_event event;
   bzero(&event, sizeof event);
-  event.events = channel->interested_events();
+  event.events = channel->registered_events();
+  if (operation == EPOLL_CTL_ADD && channel->isExclusive())
+  {
+    // EPOLLEXCLUSIVE only combines with EPOLLIN/EPOLLOUT/EPOLLET, drop EPOLLPRI
+    event.events &= EPOLLIN | EPOLLOUT | EPOLLET;
+    event.events |= EPOLLEXCLUSIVE;
+  }
   event.data.ptr = channel;
   int fd = channel->fd();
   if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
@@ -4,8 +4,10 @@
 
 #include<muduo/net/SocketOps.h>
 #include <muduo/net/EventLoop.h>
+#include <muduo/base/CountDownLatch.h>
 #include <muduo/base/Logging.h>
 #include <muduo/base/Mutex.h>
+#include <muduo/net/BufferPool.h>
 #include <muduo/net/Channel.h>
 #include <muduo/net/Poller.h>
 
@@ -61,6 +63,10 @@ EventLoop::EventLoop()
     callingPendingFunctors_(false),//是否正在调用任务处理
     iteration_(0),//事件循环次数
     threadId_(CurrentThread::tid()),
+    clockSource_(Clock::defaultSource()),
+    now_(Clock::now(clockSource_)),
+    trackLag_(false),
+    busySince_(0),
     poller_(Poller::newDefaultPoller(this)),////一个EventLoop始终持有一个Poller对象
     timerQueue_(new TimerQueue(this)),////定时器集合，一个EventLoop一个TimerQueue
     wakeupFd_(createEventfd()),////就是eventfd,实现线程唤醒,其他线程通过往loop.eventfd里写数据来唤醒当前线程
@@ -105,9 +111,23 @@ void EventLoop::loop()
   {
     activeChannels_.clear();
     
-    pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);//poll() OR epoll()
+    if (timerQueue_->usesTimerfd())
+    {
+      pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);//poll() OR epoll()
+    }
+    else
+    {
+      //没有timerfd，poll的超时时间就是最早的定时器到期的时间
+      int64_t timeoutUs = timerQueue_->pollTimeout(clockNow(), kPollTimeMs * 1000);
+      pollReturnTime_ = poller_->pollMicroSeconds(timeoutUs, &activeChannels_);
+    }
+    now_ = pollReturnTime_;//poller用本loop的时钟读取返回时间
 
     ++iteration_;
+    if (trackLag_)
+    {
+      busySince_ = pollReturnTime_.microSecondsSinceEpoch();
+    }
     if (Logger::logLevel() <= Logger::TRACE)
     {
       printActiveChannels();
@@ -121,11 +141,41 @@ void EventLoop::loop()
     }
     currentActiveChannel_ = NULL;
     eventHandling_ = false;
+    if (!timerQueue_->usesTimerfd())
+    {
+      now_ = clockNow();
+      timerQueue_->processTimers(now_);//先处理I/O，再处理到期的定时器
+    }
     doPendingFunctors();
+    if (trackLag_)
+    {
+      busySince_ = 0;
+    }
   }
   LOG_TRACE << "EventLoop " << this << " stop looping";
   looping_ = false;
 }
+// a loop blocked in poll has nothing waiting, however long its last
+// iteration took
+int64_t EventLoop::lagMicroSeconds() const
+{
+  int64_t since = busySince_;
+  if (since == 0)
+  {
+    return 0;
+  }
+  return std::max<int64_t>(clockNow().microSecondsSinceEpoch() - since, 0);
+}
+
+BufferPool* EventLoop::bufferPool()
+{
+  assertInLoopThread();
+  if (!bufferPool_)
+  {
+    bufferPool_.reset(new BufferPool(this));
+  }
+  return bufferPool_.get();
+}
 /********************管理Channel的成员函数，它们会进一步调用Poller对象的成员函数*********************/
 void EventLoop::updateChannel(Channel* channel)
 {
@@ -150,6 +200,11 @@ bool EventLoop::hasChannel(Channel* channel)
   return poller_->hasChannel(channel);
 }
 
+bool EventLoop::supportsEdgeTriggered() const
+{
+  return poller_->supportsEdgeTriggered();
+}
+
 /**************************跨线程异步调用的成员函数：*****************************************/
 void EventLoop::wakeup()//往eventfd里写
 {
@@ -194,6 +249,12 @@ void EventLoop::runInLoop(Functor cb)
     queueInLoop(std::move(cb));//不是拥有当前loop的线程，加入任务队列
   }
 }
+void EventLoop::runInLoopAndWait(const Functor& cb)
+{
+  CountDownLatch latch(1);//本线程调用时runInLoop直接执行,latch已为0
+  runInLoop([&] { cb(); latch.countDown(); });
+  latch.wait();
+}
 void EventLoop::queueInLoop(Functor cb)
 {
   {
@@ -237,13 +298,13 @@ TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
 
 TimerId EventLoop::runAfter(double delay, TimerCallback cb)
 {
-  Timestamp time(addTime(Timestamp::now(), delay));
+  Timestamp time(addTime(clockNow(), delay));
   return runAt(time, std::move(cb));
 }
 
 TimerId EventLoop::runEvery(double interval, TimerCallback cb)
 {
-  Timestamp time(addTime(Timestamp::now(), interval));
+  Timestamp time(addTime(clockNow(), interval));
   return timerQueue_->addTimer(std::move(cb), time, interval);
 }
 
@@ -252,6 +313,40 @@ void EventLoop::cancel(TimerId timerId)
   return timerQueue_->cancel(timerId);
 }
 
+void EventLoop::setClockSource(Clock::Source source)
+{
+  assertInLoopThread();
+  if (source == Clock::kTsc && !Clock::tscUsable())
+  {
+    LOG_WARN << "EventLoop::setClockSource() no invariant TSC, using gettimeofday";
+    source = Clock::kGettimeofday;
+  }
+  clockSource_ = source;
+  now_ = clockNow();
+}
+
+void EventLoop::setTimerSlack(double slackSeconds)
+{
+  timerQueue_->setSlack(
+      static_cast<int64_t>(slackSeconds * Timestamp::kMicroSecondsPerSecond));
+}
+
+void EventLoop::setTimerPollTimeout(bool on)
+{
+  timerQueue_->setPollTimeout(on);
+}
+
+bool EventLoop::timerPollTimeout() const
+{
+  return !timerQueue_->usesTimerfd();
+}
+
+void EventLoop::setTimingWheel(double tickSeconds)
+{
+  timerQueue_->setTimingWheel(
+      static_cast<int64_t>(tickSeconds * Timestamp::kMicroSecondsPerSecond));
+}
+
 //一些辅助函数：省略了muduo库中原有的一些打印日志函数
 void EventLoop::abortNotInLoopThread()
 {
@@ -4,11 +4,14 @@
 #include <muduo/net/Endian.h>
 #include <muduo/net/SocketsOps.h>
 
+#include <algorithm>
+
 #include <netdb.h>
+#include <stddef.h>  // offsetof
+#include <string.h>
 #include <strings.h>  // bzero
 #include <netinet/in.h>
-
-#include <boost/static_assert.hpp>
+#include <sys/socket.h>
 
 // INADDR_ANY use (type)value casting.
 #pragma GCC diagnostic ignored "-Wold-style-cast"
@@ -32,9 +35,8 @@ static const in_addr_t kInaddrLoopback = INADDR_LOOPBACK;
 using namespace muduo;
 using namespace muduo::net;
 
-BOOST_STATIC_ASSERT(sizeof(InetAddress) == sizeof(struct sockaddr_in));
-
 InetAddress::InetAddress(uint16_t port, bool lookbackOnly)
+  : len_(static_cast<socklen_t>(sizeof addr_))
 {
   bzero(&addr_, sizeof addr_);
   addr_.sin_family = AF_INET;
@@ -44,13 +46,100 @@ InetAddress::InetAddress(uint16_t port, bool lookbackOnly)
 }
 
 InetAddress::InetAddress(StringArg ip, uint16_t port)
+  : len_(static_cast<socklen_t>(sizeof addr_))
 {
   bzero(&addr_, sizeof addr_);
   sockets::fromIpPort(ip.c_str(), port, &addr_);
 }
 
+InetAddress::InetAddress(const struct sockaddr* addr, socklen_t len)
+{
+  bzero(&unixAddr_, sizeof unixAddr_);
+  len_ = std::min(len, static_cast<socklen_t>(sizeof unixAddr_));
+  ::memcpy(&unixAddr_, addr, len_);
+  if (len_ < sizeof(sa_family_t))
+  {
+    // unnamed AF_UNIX peers come back with just the family, or nothing
+    unixAddr_.sun_family = AF_UNIX;
+    len_ = static_cast<socklen_t>(sizeof(sa_family_t));
+  }
+}
+
+InetAddress InetAddress::fromUnixPath(StringArg path)
+{
+  struct sockaddr_un addr;
+  bzero(&addr, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  size_t len = ::strlen(path.c_str());
+  if (len >= sizeof addr.sun_path)
+  {
+    LOG_ERROR << "InetAddress::fromUnixPath path too long " << path.c_str();
+    len = sizeof addr.sun_path - 1;
+  }
+  ::memcpy(addr.sun_path, path.c_str(), len);
+  socklen_t addrlen = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + len);
+  if (len > 0 && path.c_str()[0] == '@')
+  {
+    addr.sun_path[0] = '\0';  // abstract namespace, no trailing NUL
+  }
+  else
+  {
+    addrlen += 1;
+  }
+  return InetAddress(reinterpret_cast<const struct sockaddr*>(&addr), addrlen);
+}
+
+InetAddress InetAddress::localAddressOf(int sockfd)
+{
+  struct sockaddr_un addr;
+  bzero(&addr, sizeof addr);
+  socklen_t addrlen = static_cast<socklen_t>(sizeof addr);
+  if (::getsockname(sockfd, reinterpret_cast<struct sockaddr*>(&addr), &addrlen) < 0)
+  {
+    LOG_SYSERR << "InetAddress::localAddressOf";
+  }
+  return InetAddress(reinterpret_cast<const struct sockaddr*>(&addr), addrlen);
+}
+
+InetAddress InetAddress::peerAddressOf(int sockfd)
+{
+  struct sockaddr_un addr;
+  bzero(&addr, sizeof addr);
+  socklen_t addrlen = static_cast<socklen_t>(sizeof addr);
+  if (::getpeername(sockfd, reinterpret_cast<struct sockaddr*>(&addr), &addrlen) < 0)
+  {
+    LOG_SYSERR << "InetAddress::peerAddressOf";
+  }
+  return InetAddress(reinterpret_cast<const struct sockaddr*>(&addr), addrlen);
+}
+
+const struct sockaddr* InetAddress::getSockAddr() const
+{
+  return reinterpret_cast<const struct sockaddr*>(&unixAddr_);
+}
+
+string InetAddress::unixPath() const
+{
+  assert(isUnix());
+  size_t offset = offsetof(struct sockaddr_un, sun_path);
+  if (len_ <= offset)
+  {
+    return string();
+  }
+  size_t len = len_ - offset;
+  if (unixAddr_.sun_path[0] == '\0')
+  {
+    return "@" + string(unixAddr_.sun_path + 1, len - 1);
+  }
+  return string(unixAddr_.sun_path, ::strnlen(unixAddr_.sun_path, len));
+}
+
 string InetAddress::toIpPort() const
 {
+  if (isUnix())
+  {
+    return "unix:" + unixPath();
+  }
   char buf[32];
   sockets::toIpPort(buf, sizeof buf, addr_);
   return buf;
@@ -58,6 +147,10 @@ string InetAddress::toIpPort() const
 
 string InetAddress::toIp() const
 {
+  if (isUnix())
+  {
+    return "unix:" + unixPath();
+  }
   char buf[32];
   sockets::toIp(buf, sizeof buf, addr_);
   return buf;
@@ -28,8 +28,8 @@ void PollPoller::fillActiveChannels(int numEvents,
         if (pfd->revents > 0)
         {
             --numEvents;
-            auto ch = channels_.find(pfd->fd);
-            Channel* channel = ch->second;
+            Channel* channel = findChannel(pfd->fd);
+            assert(channel != NULL);
             channel->set_revents(pfd->revents);/**设置这个Channel上的活跃事件****/
             activeChannels->emplace_back(channel);
         }
@@ -41,8 +41,26 @@ void PollPoller::fillActiveChannels(int numEvents,
 Timestamp PollPoller::poll(int timeoutMs, ChannelList* activeChannels)
 {
     int numEvents = ::poll(pollfds_.data(), pollfds_.size(), timeoutMs);
-    int savedErrno = errno;
-    Timestamp now(Timestamp::now());
+    return afterWait(numEvents, errno, activeChannels);
+}
+
+Timestamp PollPoller::pollMicroSeconds(int64_t timeoutUs, ChannelList* activeChannels)
+{
+    struct timespec ts;
+    struct timespec* timeout = NULL;//NULL表示一直等待
+    if (timeoutUs >= 0)
+    {
+        ts.tv_sec = static_cast<time_t>(timeoutUs / Timestamp::kMicroSecondsPerSecond);
+        ts.tv_nsec = static_cast<long>(timeoutUs % Timestamp::kMicroSecondsPerSecond * 1000);
+        timeout = &ts;
+    }
+    int numEvents = ::ppoll(pollfds_.data(), pollfds_.size(), timeout, NULL);
+    return afterWait(numEvents, errno, activeChannels);
+}
+
+Timestamp PollPoller::afterWait(int numEvents, int savedErrno, ChannelList* activeChannels)
+{
+    Timestamp now(clockNow());
     if (numEvents > 0)
     {
         LOG_TRACE << numEvents << " events happened";
@@ -78,7 +96,7 @@ void PollPoller::updateChannel(Channel* channel)
         pollfds_.emplace_back(pfd);
         int idx = static_cast<int>(pollfds_.size())-1;
         channel->set_index(idx);
-        channels_[pfd.fd] = channel;
+        addChannelEntry(channel);
     }
     else
     {//---------------更新事件-------------
@@ -101,7 +119,7 @@ void PollPoller::removeChannel(Channel* channel)
     LOG_TRACE << "fd = " << channel->fd();
     int idx = channel->index();
     const struct pollfd& pfd = pollfds_[idx]; (void)pfd;
-    channels_.erase(channel->fd());
+    removeChannelEntry(channel);
     if (implicit_cast<size_t>(idx) == pollfds_.size()-1)
     {
         pollfds_.pop_back();
@@ -114,7 +132,7 @@ void PollPoller::removeChannel(Channel* channel)
         {
             channelAtEnd = -channelAtEnd-1;
         }
-        channels_[channelAtEnd]->set_index(idx);
+        findChannel(channelAtEnd)->set_index(idx);
         pollfds_.pop_back();
     }
 }
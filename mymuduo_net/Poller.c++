@@ -1,13 +1,18 @@
-#include<map>
 #include <muduo/net/Poller.h>
 
 #include <muduo/net/Channel.h>
 
+#include <algorithm>
+
+#include <assert.h>
+#include <limits.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
 Poller::Poller(EventLoop* loop)
-  : ownerLoop_(loop)
+  : ownerLoop_(loop),
+    numChannels_(0)
 {
 }
 
@@ -15,9 +20,38 @@ Poller::~Poller()
 {
 }
 
+Timestamp Poller::pollMicroSeconds(int64_t timeoutUs, ChannelList* activeChannels)
+{
+  int timeoutMs = -1;
+  if (timeoutUs >= 0)
+  {
+    timeoutMs = static_cast<int>(std::min<int64_t>((timeoutUs + 999) / 1000, INT_MAX));
+  }
+  return poll(timeoutMs, activeChannels);
+}
+
 bool Poller::hasChannel(Channel* channel) const
 {
-  auto it = channels_.find(channel->fd());
-  return it != channels_.end() && it->second == channel;
+  return findChannel(channel->fd()) == channel;
+}
+
+void Poller::addChannelEntry(Channel* channel)
+{
+  size_t idx = static_cast<size_t>(channel->fd());
+  if (idx >= channels_.size())
+  {
+    channels_.resize(std::max(idx + 1, channels_.size() * 2), NULL);
+  }
+  assert(channels_[idx] == NULL);
+  channels_[idx] = channel;
+  ++numChannels_;
+}
+
+void Poller::removeChannelEntry(Channel* channel)
+{
+  size_t idx = static_cast<size_t>(channel->fd());
+  assert(idx < channels_.size() && channels_[idx] == channel);
+  channels_[idx] = NULL;
+  --numChannels_;
 }
 
@@ -0,0 +1,528 @@
+#include <muduo/net/Resolver.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/SocketsOps.h>
+
+#include <algorithm>
+#include <memory>
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint16_t kTypeA = 1;
+const uint16_t kClassIn = 1;
+const uint16_t kFlagResponse = 0x8000;
+const uint16_t kFlagRecursionDesired = 0x0100;
+const int kRcodeMask = 0x000f;
+const size_t kHeaderLength = 12;
+const size_t kMaxNameLength = 255;
+const size_t kMaxLabelLength = 63;
+const int kMaxDatagram = 1500;
+
+uint16_t get16(const unsigned char* p)
+{
+  return static_cast<uint16_t>(p[0] << 8 | p[1]);
+}
+
+uint32_t get32(const unsigned char* p)
+{
+  return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16
+       | static_cast<uint32_t>(p[2]) << 8 | p[3];
+}
+
+void put16(string* out, uint16_t x)
+{
+  out->push_back(static_cast<char>(x >> 8));
+  out->push_back(static_cast<char>(x & 0xff));
+}
+
+// lowercase, without the trailing dot of a fully qualified name
+string normalize(const string& hostname)
+{
+  string name(hostname);
+  if (!name.empty() && name.back() == '.')
+  {
+    name.pop_back();
+  }
+  for (char& c : name)
+  {
+    c = static_cast<char>(::tolower(static_cast<unsigned char>(c)));
+  }
+  return name;
+}
+
+bool encodeName(const string& name, string* out)
+{
+  if (name.empty() || name.size() > kMaxNameLength - 2)
+  {
+    return false;
+  }
+  size_t start = 0;
+  while (start <= name.size())
+  {
+    size_t dot = name.find('.', start);
+    if (dot == string::npos)
+    {
+      dot = name.size();
+    }
+    size_t labelLength = dot - start;
+    if (labelLength == 0 || labelLength > kMaxLabelLength)
+    {
+      return false;
+    }
+    out->push_back(static_cast<char>(labelLength));
+    out->append(name, start, labelLength);
+    start = dot + 1;
+  }
+  out->push_back('\0');
+  return true;
+}
+
+// reads the uncompressed name of the question section, lowercased
+bool readName(const unsigned char* packet, size_t len, size_t* pos, string* name)
+{
+  size_t p = *pos;
+  while (p < len)
+  {
+    size_t labelLength = packet[p++];
+    if (labelLength == 0)
+    {
+      *pos = p;
+      return true;
+    }
+    if (labelLength > kMaxLabelLength || p + labelLength > len
+        || name->size() + labelLength + 1 > kMaxNameLength)
+    {
+      return false;
+    }
+    if (!name->empty())
+    {
+      name->push_back('.');
+    }
+    for (size_t i = 0; i < labelLength; ++i)
+    {
+      name->push_back(static_cast<char>(::tolower(packet[p + i])));
+    }
+    p += labelLength;
+  }
+  return false;
+}
+
+// steps over a name of the answer section, which may end in a compression pointer
+bool skipName(const unsigned char* packet, size_t len, size_t* pos)
+{
+  size_t p = *pos;
+  while (p < len)
+  {
+    size_t labelLength = packet[p];
+    if ((labelLength & 0xc0) == 0xc0)
+    {
+      if (p + 2 > len)
+      {
+        return false;
+      }
+      *pos = p + 2;
+      return true;
+    }
+    if (labelLength > kMaxLabelLength)
+    {
+      return false;
+    }
+    p += 1 + labelLength;
+    if (labelLength == 0)
+    {
+      *pos = p;
+      return true;
+    }
+  }
+  return false;
+}
+
+InetAddress defaultNameserver()
+{
+  InetAddress nameserver("127.0.0.1", 53);
+  FILE* fp = ::fopen("/etc/resolv.conf", "re");
+  if (fp)
+  {
+    char line[256];
+    while (::fgets(line, sizeof line, fp))
+    {
+      char ip[64];
+      struct in_addr addr;
+      if (::sscanf(line, " nameserver %63s", ip) == 1
+          && ::inet_pton(AF_INET, ip, &addr) == 1)
+      {
+        nameserver = InetAddress(ip, 53);
+        break;
+      }
+    }
+    ::fclose(fp);
+  }
+  return nameserver;
+}
+
+}
+
+Resolver::Resolver(EventLoop* loop, const Options& options)
+  : Resolver(loop, defaultNameserver(), options)
+{
+}
+
+Resolver::Resolver(EventLoop* loop, const InetAddress& nameserver,
+                   const Options& options)
+  : loop_(loop),
+    options_(options),
+    nameserver_(nameserver),
+    sockfd_(sockets::createDgramNonblockingOrDie()),
+    channel_(loop, sockfd_),
+    idState_((static_cast<uint32_t>(::getpid()) * 2654435761u
+              ^ static_cast<uint32_t>(Timestamp::now().microSecondsSinceEpoch())) | 1),
+    numQueriesSent_(0),
+    handle_(new Resolver*(this))
+{
+  // a connected UDP socket only receives from the nameserver
+  if (sockets::connect(sockfd_, nameserver_.getSockAddrInet()) < 0)
+  {
+    LOG_SYSERR << "Resolver::Resolver connect " << nameserver_.toIpPort();
+  }
+  channel_.setReadCallback(
+      std::bind(&Resolver::handleRead, this, std::placeholders::_1));
+  channel_.enableReading();
+}
+
+Resolver::~Resolver()
+{
+  loop_->assertInLoopThread();
+  for (auto& entry : queries_)
+  {
+    loop_->cancel(entry.second.timer);
+  }
+  channel_.disableAll();
+  channel_.remove();
+  sockets::close(sockfd_);
+}
+
+void Resolver::setNameserver(const InetAddress& nameserver)
+{
+  loop_->assertInLoopThread();
+  // connecting again replaces the peer, late answers of the old one are filtered out
+  if (sockets::connect(sockfd_, nameserver.getSockAddrInet()) < 0)
+  {
+    LOG_SYSERR << "Resolver::setNameserver connect " << nameserver.toIpPort();
+  }
+  nameserver_ = nameserver;
+}
+
+void Resolver::resolve(const string& hostname, uint16_t port, Callback cb)
+{
+  if (loop_->isInLoopThread())
+  {
+    resolveInLoop(hostname, port, cb);
+  }
+  else
+  {
+    loop_->queueInLoop(std::bind(&Resolver::resolveIfAlive,
+                                 std::weak_ptr<Resolver*>(handle_),
+                                 hostname, port, std::move(cb)));
+  }
+}
+
+void Resolver::resolveIfAlive(const std::weak_ptr<Resolver*>& handle,
+                              const string& hostname, uint16_t port, const Callback& cb)
+{
+  std::shared_ptr<Resolver*> resolver(handle.lock());
+  if (resolver)
+  {
+    (*resolver)->resolveInLoop(hostname, port, cb);
+  }
+}
+
+std::future<std::vector<InetAddress>> Resolver::resolve(const string& hostname,
+                                                        uint16_t port)
+{
+  std::shared_ptr<std::promise<std::vector<InetAddress>>> promise(
+      new std::promise<std::vector<InetAddress>>);
+  std::future<std::vector<InetAddress>> result = promise->get_future();
+  resolve(hostname, port, [promise](const std::vector<InetAddress>& addrs) {
+    promise->set_value(addrs);
+  });
+  return result;
+}
+
+void Resolver::clearCache()
+{
+  loop_->assertInLoopThread();
+  cache_.clear();
+}
+
+void Resolver::resolveInLoop(const string& hostname, uint16_t port, const Callback& cb)
+{
+  loop_->assertInLoopThread();
+  Waiter waiter = { port, cb };
+  std::vector<uint32_t> ips;
+
+  struct in_addr numeric;
+  if (::inet_pton(AF_INET, hostname.c_str(), &numeric) == 1)
+  {
+    ips.push_back(numeric.s_addr);
+    deliver(ips, waiter);
+    return;
+  }
+
+  string name(normalize(hostname));
+  auto cached = cache_.find(name);
+  if (cached != cache_.end())
+  {
+    if (loop_->now() < cached->second.expiration)
+    {
+      deliver(cached->second.ips, waiter);
+      return;
+    }
+    cache_.erase(cached);
+  }
+
+  auto pending = queryOfName_.find(name);
+  if (pending != queryOfName_.end())
+  {
+    queries_[pending->second].waiters.push_back(waiter);
+    return;
+  }
+
+  string encoded;
+  if (!encodeName(name, &encoded))
+  {
+    LOG_ERROR << "Resolver::resolve invalid hostname " << hostname;
+    deliver(ips, waiter);
+    return;
+  }
+
+  uint16_t id = nextId();
+  Query& query = queries_[id];
+  query.hostname = name;
+  query.waiters.push_back(waiter);
+  query.attempts = 1;
+  queryOfName_[name] = id;
+  send(id, query);
+  query.timer = loop_->runAfter(options_.timeoutSeconds,
+                                std::bind(&Resolver::onTimeout, this, id));
+}
+
+uint16_t Resolver::nextId()
+{
+  uint16_t id;
+  do
+  {
+    idState_ ^= idState_ << 13;
+    idState_ ^= idState_ >> 17;
+    idState_ ^= idState_ << 5;
+    id = static_cast<uint16_t>(idState_ >> 16);
+  } while (queries_.count(id));
+  return id;
+}
+
+void Resolver::send(uint16_t id, const Query& query)
+{
+  string packet;
+  packet.reserve(kHeaderLength + query.hostname.size() + 6);
+  put16(&packet, id);
+  put16(&packet, kFlagRecursionDesired);
+  put16(&packet, 1);  // questions
+  put16(&packet, 0);  // answers
+  put16(&packet, 0);  // authorities
+  put16(&packet, 0);  // additionals
+  encodeName(query.hostname, &packet);
+  put16(&packet, kTypeA);
+  put16(&packet, kClassIn);
+
+  ++numQueriesSent_;
+  ssize_t n = ::send(sockfd_, packet.data(), packet.size(), 0);
+  if (n != static_cast<ssize_t>(packet.size()))
+  {
+    // the timeout resends
+    LOG_SYSERR << "Resolver::send " << query.hostname;
+  }
+}
+
+void Resolver::handleRead(Timestamp receiveTime)
+{
+  loop_->assertInLoopThread();
+  char packet[kMaxDatagram];
+  for (;;)
+  {
+    ssize_t n = ::recv(sockfd_, packet, sizeof packet, 0);
+    if (n < 0)
+    {
+      // ECONNREFUSED reports an ICMP error for an earlier query, the timeout resends
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      {
+        LOG_SYSERR << "Resolver::handleRead";
+      }
+      if (errno != EINTR && errno != ECONNREFUSED)
+      {
+        break;
+      }
+      continue;
+    }
+    onResponse(packet, static_cast<size_t>(n), receiveTime);
+  }
+}
+
+void Resolver::onResponse(const char* data, size_t len, Timestamp receiveTime)
+{
+  const unsigned char* packet = reinterpret_cast<const unsigned char*>(data);
+  if (len < kHeaderLength)
+  {
+    return;
+  }
+  QueryMap::iterator it = queries_.find(get16(packet));
+  uint16_t flags = get16(packet + 2);
+  if (it == queries_.end() || !(flags & kFlagResponse) || get16(packet + 4) != 1)
+  {
+    return;  // late, duplicate or not ours
+  }
+
+  size_t pos = kHeaderLength;
+  string name;
+  if (!readName(packet, len, &pos, &name) || name != it->second.hostname
+      || pos + 4 > len)
+  {
+    return;
+  }
+  pos += 4;  // type, class
+
+  std::vector<uint32_t> ips;
+  uint32_t ttl = static_cast<uint32_t>(options_.maxTtlSeconds);
+  int rcode = flags & kRcodeMask;
+  if (rcode == 0)
+  {
+    int answers = get16(packet + 6);
+    for (int i = 0; i < answers; ++i)
+    {
+      if (!skipName(packet, len, &pos) || pos + 10 > len)
+      {
+        return;  // malformed, the timeout resends
+      }
+      uint16_t type = get16(packet + pos);
+      uint16_t klass = get16(packet + pos + 2);
+      uint32_t recordTtl = get32(packet + pos + 4);
+      uint16_t rdlength = get16(packet + pos + 8);
+      pos += 10;
+      if (pos + rdlength > len)
+      {
+        return;
+      }
+      // CNAME records ahead of the addresses are skipped
+      if (type == kTypeA && klass == kClassIn && rdlength == sizeof(uint32_t))
+      {
+        uint32_t ip;
+        ::memcpy(&ip, packet + pos, sizeof ip);
+        ips.push_back(ip);
+        ttl = std::min(ttl, recordTtl);
+      }
+      pos += rdlength;
+    }
+  }
+  else
+  {
+    LOG_WARN << "Resolver " << it->second.hostname << " rcode " << rcode;
+  }
+
+  if (!ips.empty())
+  {
+    addToCache(it->second.hostname, ips, ttl, receiveTime);
+  }
+  finish(it, ips);
+}
+
+void Resolver::onTimeout(uint16_t id)
+{
+  QueryMap::iterator it = queries_.find(id);
+  assert(it != queries_.end());
+  Query& query = it->second;
+  if (query.attempts <= options_.retries)
+  {
+    ++query.attempts;
+    send(id, query);
+    query.timer = loop_->runAfter(options_.timeoutSeconds,
+                                  std::bind(&Resolver::onTimeout, this, id));
+  }
+  else
+  {
+    LOG_WARN << "Resolver " << query.hostname << " timed out after "
+             << query.attempts << " attempts";
+    query.timer = TimerId();
+    finish(it, std::vector<uint32_t>());
+  }
+}
+
+void Resolver::finish(QueryMap::iterator it, const std::vector<uint32_t>& ips)
+{
+  // callbacks may resolve again, the query is gone by then
+  Query query(std::move(it->second));
+  queries_.erase(it);
+  queryOfName_.erase(query.hostname);
+  loop_->cancel(query.timer);
+  for (const Waiter& waiter : query.waiters)
+  {
+    deliver(ips, waiter);
+  }
+}
+
+void Resolver::addToCache(const string& hostname, const std::vector<uint32_t>& ips,
+                          uint32_t ttlSeconds, Timestamp now)
+{
+  if (ttlSeconds == 0 || options_.maxCacheEntries == 0)
+  {
+    return;
+  }
+  if (cache_.size() >= options_.maxCacheEntries)
+  {
+    for (auto it = cache_.begin(); it != cache_.end(); )
+    {
+      if (it->second.expiration < now)
+      {
+        it = cache_.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+    if (cache_.size() >= options_.maxCacheEntries)
+    {
+      cache_.erase(cache_.begin());
+    }
+  }
+  CacheEntry& entry = cache_[hostname];
+  entry.ips = ips;
+  entry.expiration = addTime(now, ttlSeconds);
+}
+
+void Resolver::deliver(const std::vector<uint32_t>& ips, const Waiter& waiter)
+{
+  std::vector<InetAddress> addrs;
+  addrs.reserve(ips.size());
+  for (uint32_t ip : ips)
+  {
+    struct sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = ip;
+    addr.sin_port = htons(waiter.port);
+    addrs.push_back(InetAddress(addr));
+  }
+  waiter.cb(addrs);
+}
@@ -2,10 +2,13 @@
 
 #include <muduo/base/Logging.h>
 #include <muduo/net/InetAddress.h>
+#include <muduo/net/SocketProfile.h>
 #include <muduo/net/SocketsOps.h>
 
+#include <linux/filter.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/un.h>
 #include<stdio.h>
 #include<stdlib.h>
 
@@ -61,7 +64,7 @@ bool Socket::getTcpInfoString(char* buf, int len) const
 }
 void Socket::bindAddress(const InetAddress& addr)
 {
-  sockets::bindOrDie(sockfd_, addr.getSockAddrInet());
+  sockets::bindOrDie(sockfd_, addr.getSockAddr(), addr.sockLen());
 }
 
 void Socket::listen()
@@ -71,12 +74,13 @@ void Socket::listen()
 
 int Socket::accept(InetAddress* peeraddr)
 {
-  struct sockaddr_in addr;
+  struct sockaddr_un addr;  // large enough for either family
   bzero(&addr, sizeof addr);
-  int connfd = sockets::accept(sockfd_, &addr);
+  socklen_t addrlen = static_cast<socklen_t>(sizeof addr);
+  int connfd = sockets::accept(sockfd_, reinterpret_cast<struct sockaddr*>(&addr), &addrlen);
   if (connfd >= 0)
   {
-    peeraddr->setSockAddrInet(addr);
+    *peeraddr = InetAddress(reinterpret_cast<struct sockaddr*>(&addr), addrlen);
   }
   return connfd;
 }
@@ -128,3 +132,157 @@ void Socket::setKeepAlive(bool on)
   // FIXME CHECK
 }
 
+void Socket::setFastOpen(int queueLength)
+{
+  int ret = ::setsockopt(sockfd_, IPPROTO_TCP, TCP_FASTOPEN,
+                         &queueLength, static_cast<socklen_t>(sizeof queueLength));
+  if (ret < 0)
+  {
+    LOG_SYSERR << "TCP_FASTOPEN failed.";
+  }
+}
+
+void Socket::setDeferAccept(int seconds)
+{
+  int ret = ::setsockopt(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+                         &seconds, static_cast<socklen_t>(sizeof seconds));
+  if (ret < 0)
+  {
+    LOG_SYSERR << "TCP_DEFER_ACCEPT failed.";
+  }
+}
+
+void Socket::setNotSentLowat(int bytes)
+{
+  int ret = ::setsockopt(sockfd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                         &bytes, static_cast<socklen_t>(sizeof bytes));
+  if (ret < 0)
+  {
+    LOG_SYSERR << "TCP_NOTSENT_LOWAT failed.";
+  }
+}
+
+void Socket::setRecvBuffer(int bytes)
+{
+  int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF,
+                         &bytes, static_cast<socklen_t>(sizeof bytes));
+  if (ret < 0)
+  {
+    LOG_SYSERR << "SO_RCVBUF failed.";
+  }
+}
+
+void Socket::setSendBuffer(int bytes)
+{
+  int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_SNDBUF,
+                         &bytes, static_cast<socklen_t>(sizeof bytes));
+  if (ret < 0)
+  {
+    LOG_SYSERR << "SO_SNDBUF failed.";
+  }
+}
+
+void Socket::setQuickAck(bool on)
+{
+  int optval = on ? 1 : 0;
+  ::setsockopt(sockfd_, IPPROTO_TCP, TCP_QUICKACK,
+               &optval, static_cast<socklen_t>(sizeof optval));
+  // FIXME CHECK
+}
+
+void Socket::applyListenerProfile(const SocketProfile& profile, bool tcp)
+{
+  // buffers before listen(), the window scale of accepted sockets depends on them
+  if (profile.recvBuffer > 0)
+  {
+    setRecvBuffer(profile.recvBuffer);
+  }
+  if (profile.sendBuffer > 0)
+  {
+    setSendBuffer(profile.sendBuffer);
+  }
+  if (!tcp)
+  {
+    return;
+  }
+  if (profile.fastOpenQueue > 0)
+  {
+    setFastOpen(profile.fastOpenQueue);
+  }
+  if (profile.deferAcceptSeconds > 0)
+  {
+    setDeferAccept(profile.deferAcceptSeconds);
+  }
+}
+
+void Socket::applyConnectionProfile(const SocketProfile& profile, bool tcp)
+{
+  if (profile.recvBuffer > 0)
+  {
+    setRecvBuffer(profile.recvBuffer);
+  }
+  if (profile.sendBuffer > 0)
+  {
+    setSendBuffer(profile.sendBuffer);
+  }
+  if (!tcp)
+  {
+    return;
+  }
+  if (profile.keepAlive)
+  {
+    setKeepAlive(true);
+  }
+  if (profile.tcpNoDelay)
+  {
+    setTcpNoDelay(true);
+  }
+  if (profile.quickAck)
+  {
+    setQuickAck(true);
+  }
+  if (profile.notSentLowat > 0)
+  {
+    setNotSentLowat(profile.notSentLowat);
+  }
+}
+
+void Socket::setIncomingCpu(int cpu)
+{
+#ifdef SO_INCOMING_CPU
+  int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_INCOMING_CPU,
+                         &cpu, static_cast<socklen_t>(sizeof cpu));
+  if (ret < 0)
+  {
+    LOG_SYSERR << "SO_INCOMING_CPU failed.";
+  }
+#else
+  LOG_ERROR << "SO_INCOMING_CPU is not supported.";
+#endif
+}
+
+bool Socket::attachReusePortCpuSteering(int groupSize)
+{
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+  assert(groupSize > 0);
+  // A = cpu; A = A % groupSize; return A
+  struct sock_filter code[] = {
+    { BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU) },
+    { BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(groupSize) },
+    { BPF_RET | BPF_A, 0, 0, 0 },
+  };
+  struct sock_fprog prog;
+  prog.len = static_cast<unsigned short>(sizeof code / sizeof code[0]);
+  prog.filter = code;
+  int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                         &prog, static_cast<socklen_t>(sizeof prog));
+  if (ret < 0)
+  {
+    LOG_SYSERR << "SO_ATTACH_REUSEPORT_CBPF failed.";
+  }
+  return ret == 0;
+#else
+  LOG_ERROR << "SO_ATTACH_REUSEPORT_CBPF is not supported.";
+  return false;
+#endif
+}
@@ -3,9 +3,11 @@
 #include <muduo/base/Logging.h>
 #include <muduo/base/Types.h>
 #include <muduo/net/Endian.h>
+#include <muduo/net/TcpStats.h>
 
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/tcp.h>  // not <netinet/tcp.h>, its tcp_info lacks the newer fields
 #include <stdio.h>  // snprintf
 #include <strings.h>  // bzero
 #include <sys/socket.h>
@@ -50,10 +52,11 @@ void setNonBlockAndCloseOnExec(int sockfd)
 
 }
 
-int sockets::createNonblockingOrDie()
+int sockets::createNonblockingOrDie(sa_family_t family)
 {
+  int protocol = family == AF_INET ? IPPROTO_TCP : 0;
 #if VALGRIND
-  int sockfd = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  int sockfd = ::socket(family, SOCK_STREAM, protocol);
   if (sockfd < 0)
   {
     LOG_SYSFATAL << "sockets::createNonblockingOrDie";
@@ -61,7 +64,7 @@ int sockets::createNonblockingOrDie()
 
   setNonBlockAndCloseOnExec(sockfd);
 #else
-  int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+  int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
   if (sockfd < 0)
   {
     LOG_SYSFATAL << "sockets::createNonblockingOrDie";
@@ -70,9 +73,35 @@ int sockets::createNonblockingOrDie()
   return sockfd;
 }
 
+int sockets::createDgramNonblockingOrDie(sa_family_t family)
+{
+  int protocol = family == AF_INET ? IPPROTO_UDP : 0;
+#if VALGRIND
+  int sockfd = ::socket(family, SOCK_DGRAM, protocol);
+  if (sockfd < 0)
+  {
+    LOG_SYSFATAL << "sockets::createDgramNonblockingOrDie";
+  }
+
+  setNonBlockAndCloseOnExec(sockfd);
+#else
+  int sockfd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+  if (sockfd < 0)
+  {
+    LOG_SYSFATAL << "sockets::createDgramNonblockingOrDie";
+  }
+#endif
+  return sockfd;
+}
+
 void sockets::bindOrDie(int sockfd, const struct sockaddr_in& addr)
 {
-  int ret = ::bind(sockfd, sockaddr_cast(&addr), static_cast<socklen_t>(sizeof addr));
+  bindOrDie(sockfd, sockaddr_cast(&addr), static_cast<socklen_t>(sizeof addr));
+}
+
+void sockets::bindOrDie(int sockfd, const struct sockaddr* addr, socklen_t addrlen)
+{
+  int ret = ::bind(sockfd, addr, addrlen);
   if (ret < 0)
   {
     LOG_SYSFATAL << "sockets::bindOrDie";
@@ -91,17 +120,25 @@ void sockets::listenOrDie(int sockfd)
 int sockets::accept(int sockfd, struct sockaddr_in* addr)
 {
   socklen_t addrlen = static_cast<socklen_t>(sizeof *addr);
+  return sockets::accept(sockfd, sockaddr_cast(addr), &addrlen);
+}
+
+int sockets::accept(int sockfd, struct sockaddr* addr, socklen_t* addrlen)
+{
 #if VALGRIND
-  int connfd = ::accept(sockfd, sockaddr_cast(addr), &addrlen);
+  int connfd = ::accept(sockfd, addr, addrlen);
   setNonBlockAndCloseOnExec(connfd);
 #else
-  int connfd = ::accept4(sockfd, sockaddr_cast(addr),
-                         &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  int connfd = ::accept4(sockfd, addr,
+                         addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
 #endif
   if (connfd < 0)
   {
     int savedErrno = errno;
-    LOG_SYSERR << "Socket::accept";
+    if (savedErrno != EAGAIN)  // the normal end of an accept batch
+    {
+      LOG_SYSERR << "Socket::accept";
+    }
     switch (savedErrno)
     {
       case EAGAIN:
@@ -137,6 +174,11 @@ int sockets::connect(int sockfd, const struct sockaddr_in& addr)
   return ::connect(sockfd, sockaddr_cast(&addr), static_cast<socklen_t>(sizeof addr));
 }
 
+int sockets::connect(int sockfd, const struct sockaddr* addr, socklen_t addrlen)
+{
+  return ::connect(sockfd, addr, addrlen);
+}
+
 ssize_t sockets::read(int sockfd, void *buf, size_t count)
 {
   return ::read(sockfd, buf, count);
@@ -244,3 +286,30 @@ bool sockets::isSelfConnect(int sockfd)
       && localaddr.sin_addr.s_addr == peeraddr.sin_addr.s_addr;
 }
 
+
+bool sockets::getTcpStats(int sockfd, struct TcpStats* stats)
+{
+  struct tcp_info tcpi;
+  bzero(&tcpi, sizeof tcpi);
+  socklen_t len = static_cast<socklen_t>(sizeof tcpi);
+  if (::getsockopt(sockfd, IPPROTO_TCP, TCP_INFO, &tcpi, &len) < 0)
+  {
+    return false;
+  }
+  stats->rttUs = tcpi.tcpi_rtt;
+  stats->rttVarUs = tcpi.tcpi_rttvar;
+  stats->minRttUs = tcpi.tcpi_min_rtt;
+  stats->rtoUs = tcpi.tcpi_rto;
+  stats->sndMss = tcpi.tcpi_snd_mss;
+  stats->sndCwnd = tcpi.tcpi_snd_cwnd;
+  stats->sndSsthresh = tcpi.tcpi_snd_ssthresh;
+  stats->unacked = tcpi.tcpi_unacked;
+  stats->lost = tcpi.tcpi_lost;
+  stats->retrans = tcpi.tcpi_retrans;
+  stats->totalRetrans = tcpi.tcpi_total_retrans;
+  stats->notSentBytes = tcpi.tcpi_notsent_bytes;
+  stats->deliveryRate = tcpi.tcpi_delivery_rate;
+  stats->bytesAcked = tcpi.tcpi_bytes_acked;
+  stats->bytesReceived = tcpi.tcpi_bytes_received;
+  return true;
+}
@@ -0,0 +1,160 @@
+#include <muduo/net/TcpClient.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/Connector.h>
+#include <muduo/net/EventLoop.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace muduo
+{
+namespace net
+{
+namespace detail
+{
+
+void removeConnection(EventLoop* loop, const TcpConnectionPtr& conn)
+{
+  loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+}
+}
+}
+
+TcpClient::TcpClient(EventLoop* loop,
+                     const InetAddress& serverAddr,
+                     const string& nameArg)
+  : loop_(CHECK_NOTNULL(loop)),
+    connector_(new Connector(loop, serverAddr)),
+    name_(nameArg),
+    connNamePrefix_(std::make_shared<const string>(name_ + ":" + serverAddr.toIpPort())),
+    connectionCallback_(defaultConnectionCallback),
+    messageCallback_(defaultMessageCallback),
+    edgeTriggered_(false),
+    retry_(false),
+    connect_(true),
+    nextConnId_(1)
+{
+  connector_->setNewConnectionCallback(
+      std::bind(&TcpClient::newConnection, this, _1));
+  // FIXME setConnectFailedCallback
+  LOG_INFO << "TcpClient::TcpClient[" << name_
+           << "] - connector " << get_pointer(connector_);
+}
+
+TcpClient::~TcpClient()
+{
+  LOG_INFO << "TcpClient::~TcpClient[" << name_
+           << "] - connector " << get_pointer(connector_);
+  TcpConnectionPtr conn;
+  bool unique = false;
+  {
+    MutexLockGuard lock(mutex_);
+    // besides ours, the only reference is the connection's own self_,
+    // held from connectEstablished() till connectDestroyed()
+    unique = connection_.use_count() <= 2;
+    conn = connection_;
+  }
+  if (conn)
+  {
+    assert(loop_ == conn->getLoop());
+    // FIXME: not 100% safe, if we are in different thread
+    CloseCallback cb = std::bind(&detail::removeConnection, loop_, _1);
+    loop_->runInLoop(
+        std::bind(&TcpConnection::setCloseCallback, conn, cb));
+    if (unique)
+    {
+      conn->forceClose();
+    }
+  }
+  else
+  {
+    // the queued stopInLoop() holds the Connector till it is done
+    connector_->stop();
+  }
+}
+
+void TcpClient::setRetryDelay(int initRetryDelayMs, int maxRetryDelayMs)
+{
+  connector_->setRetryDelay(initRetryDelayMs, maxRetryDelayMs);
+}
+
+void TcpClient::connect()
+{
+  // FIXME: check state
+  LOG_INFO << "TcpClient::connect[" << name_ << "] - connecting to "
+           << connector_->serverAddress().toIpPort();
+  connect_ = true;
+  connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+  connect_ = false;
+
+  {
+    MutexLockGuard lock(mutex_);
+    if (connection_)
+    {
+      connection_->shutdown();
+    }
+  }
+}
+
+void TcpClient::stop()
+{
+  connect_ = false;
+  connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd)
+{
+  loop_->assertInLoopThread();
+  InetAddress peerAddr(InetAddress::peerAddressOf(sockfd));
+  uint64_t id = nextConnId_++;  // named lazily, see TcpConnection::name()
+
+  InetAddress localAddr(InetAddress::localAddressOf(sockfd));
+  // FIXME poll with zero timeout to double confirm the new connection
+  // FIXME use make_shared if necessary
+  TcpConnectionPtr conn(new TcpConnection(loop_,
+                                          id,
+                                          connNamePrefix_,
+                                          sockfd,
+                                          localAddr,
+                                          peerAddr));
+
+  conn->setSocketProfile(profile_);
+  conn->setEdgeTriggered(edgeTriggered_);
+  conn->setConnectionCallback(connectionCallback_);
+  conn->setMessageCallback(messageCallback_);
+  conn->setWriteCompleteCallback(writeCompleteCallback_);
+  conn->setCloseCallback(
+      std::bind(&TcpClient::removeConnection, this, _1)); // FIXME: unsafe
+  {
+    MutexLockGuard lock(mutex_);
+    connection_ = conn;
+  }
+  conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr& conn)
+{
+  loop_->assertInLoopThread();
+  assert(loop_ == conn->getLoop());
+
+  {
+    MutexLockGuard lock(mutex_);
+    assert(connection_ == conn);
+    connection_.reset();
+  }
+
+  loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+  if (retry_ && connect_)
+  {
+    LOG_INFO << "TcpClient::connect[" << name_ << "] - Reconnecting to "
+             << connector_->serverAddress().toIpPort();
+    connector_->restart();
+  }
+}
@@ -1,13 +1,21 @@
 #include <muduo/net/TcpConnection.h>
 
 #include <muduo/base/Logging.h>
+#include <muduo/base/Mutex.h>
 #include <muduo/base/WeakCallback.h>
+#include <muduo/net/BufferPool.h>
 #include <muduo/net/Channel.h>
 #include <muduo/net/EventLoop.h>
+#include <muduo/net/RateLimiter.h>
 #include <muduo/net/Socket.h>
+#include <muduo/net/SocketProfile.h>
 #include <muduo/net/SocketsOps.h>
 
 #include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <mutex>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -27,50 +35,199 @@ void muduo::net::defaultMessageCallback(const TcpConnectionPtr&,
   buf->retrieveAll();
 }
 
+const size_t TcpConnection::kWriteQuantum;
+
+// set up and torn down with the connection, or statistics
+struct TcpConnection::Cold
+{
+  Cold(const string& nameArg, uint64_t idArg, const std::shared_ptr<const string>& prefix,
+       const InetAddress& local, const InetAddress& peer)
+    : id(idArg),
+      namePrefix(prefix),
+      name(nameArg),
+      localAddr(local),
+      peerAddr(peer),
+      numReadPauses(0),
+      readPausedMicroSeconds(0),
+      numReadThrottles(0),
+      numWriteThrottles(0),
+      numMigrations(0),
+      edgeTriggered(false)
+  { }
+
+  const uint64_t id;
+  const std::shared_ptr<const string> namePrefix;  // NULL if named up front
+  std::once_flag nameFormatted;
+  string name;  // see name()
+  const InetAddress localAddr;
+  const InetAddress peerAddr;
+  ConnectionCallback connectionCallback;
+  HighWaterMarkCallback highWaterMarkCallback;
+  CloseCallback closeCallback;
+  ConnectionCallback migratedCallback;
+  std::weak_ptr<TcpConnection> flowSource;  // may be this
+  int64_t numReadPauses;
+  int64_t readPausedMicroSeconds;
+  Timestamp readPausedSince;
+  int64_t numReadThrottles;
+  int64_t numWriteThrottles;
+  int64_t numMigrations;
+  bool edgeTriggered;  // asked for, see setEdgeTriggered()
+  std::shared_ptr<const LoopRateLimiters> loopRateLimiters;
+  MutexLock orderedMutex;
+  std::vector<Functor> ordered;  // @GuardedBy orderedMutex, see runOrdered()
+};
+
 TcpConnection::TcpConnection(EventLoop* loop,
                              const string& nameArg,
                              int sockfd,
                              const InetAddress& localAddr,
                              const InetAddress& peerAddr)
+  : TcpConnection(loop,
+                  new Cold(nameArg, 0, std::shared_ptr<const string>(), localAddr, peerAddr),
+                  sockfd)
+{
+}
+
+TcpConnection::TcpConnection(EventLoop* loop,
+                             uint64_t id,
+                             const std::shared_ptr<const string>& namePrefix,
+                             int sockfd,
+                             const InetAddress& localAddr,
+                             const InetAddress& peerAddr)
+  : TcpConnection(loop, new Cold(string(), id, namePrefix, localAddr, peerAddr), sockfd)
+{
+}
+
+TcpConnection::TcpConnection(EventLoop* loop, Cold* cold, int sockfd)
   : loop_(CHECK_NOTNULL(loop)),
-    name_(nameArg),
+    channel_(new Channel(loop, sockfd)),
     state_(kConnecting),
     reading_(true),
+    awaitingLowat_(false),
+    backlogged_(false),
+    readThrottled_(false),
+    writeThrottled_(false),
+    quickAck_(false),
+    readBlocks_(0),
+    notSentLowat_(0),
+    orderedQueued_(false),
+    highWaterMark_(64*1024*1024),
+    flowHighMark_(0),
+    flowLowMark_(0),
     socket_(new Socket(sockfd)),
-    channel_(new Channel(loop, sockfd)),
-    localAddr_(localAddr),
-    peerAddr_(peerAddr),
-    highWaterMark_(64*1024*1024)
-{
-  channel_->setReadCallback(
-      std::bind(&TcpConnection::handleRead, this, _1));
-  channel_->setWriteCallback(
-      std::bind(&TcpConnection::handleWrite, this));
-  channel_->setCloseCallback(
-      std::bind(&TcpConnection::handleClose, this));
-  channel_->setErrorCallback(
-      std::bind(&TcpConnection::handleError, this));
-  LOG_DEBUG << "TcpConnection::ctor[" <<  name_ << "] at " << this
+    cold_(cold)
+{
+  setChannelHandler();
+  LOG_DEBUG << "TcpConnection::ctor[" <<  name() << "] at " << this
             << " fd=" << sockfd;
-  socket_->setKeepAlive(true);
+}
+
+void TcpConnection::setChannelHandler()
+{
+  // one virtual call per event, no std::function in the Channel
+  channel_->setEventHandler(this);
 }
 
 TcpConnection::~TcpConnection()
 {
-  LOG_DEBUG << "TcpConnection::dtor[" <<  name_ << "] at " << this
+  LOG_DEBUG << "TcpConnection::dtor[" <<  name() << "] at " << this
             << " fd=" << channel_->fd()
             << " state=" << stateToString();
   assert(state_ == kDisconnected);
 }
 
+uint64_t TcpConnection::id() const
+{
+  return cold_->id;
+}
+
+// formatted at the first call, most connections are never asked;
+// call_once since any thread may log the name.
+const string& TcpConnection::name() const
+{
+  Cold* cold = get_pointer(cold_);
+  std::call_once(cold->nameFormatted, [cold] {
+    if (cold->namePrefix)
+    {
+      char buf[32];
+      snprintf(buf, sizeof buf, "#%" PRIu64, cold->id);
+      cold->name = *cold->namePrefix + buf;
+    }
+  });
+  return cold->name;
+}
+
+const InetAddress& TcpConnection::localAddress() const
+{
+  return cold_->localAddr;
+}
+
+const InetAddress& TcpConnection::peerAddress() const
+{
+  return cold_->peerAddr;
+}
+
+void TcpConnection::setConnectionCallback(const ConnectionCallback& cb)
+{
+  cold_->connectionCallback = cb;
+}
+
+void TcpConnection::setHighWaterMarkCallback(const HighWaterMarkCallback& cb,
+                                             size_t highWaterMark)
+{
+  cold_->highWaterMarkCallback = cb;
+  highWaterMark_ = highWaterMark;
+}
+
+void TcpConnection::setCloseCallback(const CloseCallback& cb)
+{
+  cold_->closeCallback = cb;
+}
+
+void TcpConnection::setMigratedCallback(const ConnectionCallback& cb)
+{
+  cold_->migratedCallback = cb;
+}
+
+int64_t TcpConnection::numMigrations() const
+{
+  return cold_->numMigrations;
+}
+
+int64_t TcpConnection::numReadPauses() const
+{
+  return cold_->numReadPauses;
+}
+
+double TcpConnection::readPausedSeconds() const
+{
+  return static_cast<double>(cold_->readPausedMicroSeconds) / Timestamp::kMicroSecondsPerSecond;
+}
+
+int64_t TcpConnection::numReadThrottles() const
+{
+  return cold_->numReadThrottles;
+}
+
+int64_t TcpConnection::numWriteThrottles() const
+{
+  return cold_->numWriteThrottles;
+}
+
 bool TcpConnection::getTcpInfo(struct tcp_info* tcpi) const
 {
   return socket_->getTcpInfo(tcpi);
 }
 
+bool TcpConnection::getTcpStats(struct TcpStats* stats) const
+{
+  return sockets::getTcpStats(socket_->fd(), stats);
+}
+
 string TcpConnection::getTcpInfoString() const
 {
-  char buf[1024];
+  char buf[256];
   buf[0] = '\0';
   socket_->getTcpInfoString(buf, sizeof buf);
   return buf;
@@ -85,16 +242,16 @@ void TcpConnection::send(const StringPiece& message)
 {
   if (state_ == kConnected)
   {
-    if (loop_->isInLoopThread())
+    if (canRunInLoop())
     {
       sendInLoop(message);
     }
     else
     {
       void (TcpConnection::*fp)(const StringPiece& message) = &TcpConnection::sendInLoop;
-      loop_->runInLoop(
+      runOrdered(
           std::bind(fp,
-                    this,     // FIXME
+                    shared_from_this(),
                     message.as_string()));
                     //std::forward<string>(message)));
     }
@@ -105,7 +262,7 @@ void TcpConnection::send(Buffer* buf)
 {
   if (state_ == kConnected)
   {
-    if (loop_->isInLoopThread())
+    if (canRunInLoop())
     {
       sendInLoop(buf->peek(), buf->readableBytes());
       buf->retrieveAll();
@@ -113,9 +270,9 @@ void TcpConnection::send(Buffer* buf)
     else
     {
       void (TcpConnection::*fp)(const StringPiece& message) = &TcpConnection::sendInLoop;
-      loop_->runInLoop(
+      runOrdered(
           std::bind(fp,
-                    this,     // FIXME
+                    shared_from_this(),
                     buf->retrieveAllAsString()));
                     //std::forward<string>(message)));
     }
@@ -129,29 +286,46 @@ void TcpConnection::sendInLoop(const StringPiece& message)
 
 void TcpConnection::sendInLoop(const void* data, size_t len)
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   ssize_t nwrote = 0;
   size_t remaining = len;
   bool faultError = false;
+  bool socketFull = false;  // the next EPOLLOUT edge is still to come
   if (state_ == kDisconnected)
   {
     return;
   }
   // if no thing in output queue, try writing directly
-  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+  if (!channel_->isWriting() && !writeThrottled_ && outputBytes() == 0)
   {
-    nwrote = sockets::write(channel_->fd(), data, len);
+    size_t allowed = rateLimited() ? writeAllowance(len, getLoop()->now()) : len;
+    nwrote = allowed > 0 ? sockets::write(channel_->fd(), data, allowed) : 0;
     if (nwrote >= 0)
     {
+      if (nwrote > 0 && rateLimited())
+      {
+        chargeWrite(nwrote);
+      }
       remaining = len - nwrote;
+      socketFull = static_cast<size_t>(nwrote) < allowed;
       if (remaining == 0 && writeCompleteCallback_)
       {
-        loop_->queueInLoop(std::bind(writeCompleteCallback_,shared_from_this()));
+        if (notSentLowat_ > 0)
+        {
+          // complete once the kernel queue drains below the low water mark
+          awaitingLowat_ = true;
+          channel_->enableWriting();
+        }
+        else
+        {
+          queueOnOwnLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        }
       }
     }
     else // nwrote < 0
     {
       nwrote = 0;
+      socketFull = true;
       if (errno != EWOULDBLOCK)
       {
         LOG_SYSERR << "TcpConnection::sendInLoop";
@@ -166,17 +340,36 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
   assert(remaining <= len);
   if (!faultError && remaining > 0)
   {
-    size_t oldLen = outputBuffer_.readableBytes();
+    size_t oldLen = outputBytes();
     if (oldLen + remaining >= highWaterMark_
         && oldLen < highWaterMark_
-        && highWaterMarkCallback_)
+        && cold_->highWaterMarkCallback)
     {
-      loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+      queueOnOwnLoop(std::bind(cold_->highWaterMarkCallback, shared_from_this(), oldLen + remaining));
     }
-    outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);
-    if (!channel_->isWriting())
+    acquire(&outputBuffer_)->append(static_cast<const char*>(data)+nwrote, remaining);
+    awaitingLowat_ = false;
+    if (flowHighMark_ > 0 && !backlogged_
+        && outputBytes() >= flowHighMark_)
     {
-      channel_->enableWriting();
+      setBacklogged(true);
+    }
+    if (!channel_->isWriting() && !writeThrottled_)
+    {
+      double wait = rateLimited()
+                    ? writeWait(getLoop()->now(), outputBytes()) : 0.0;
+      if (wait > 0.0)
+      {
+        throttleWrite(wait);
+      }
+      else if (socketFull)
+      {
+        channel_->enableWritingAfterShortWrite();
+      }
+      else
+      {
+        channel_->enableWriting();
+      }
     }
   }
 }
@@ -187,15 +380,25 @@ void TcpConnection::shutdown()
   if (state_ == kConnected)
   {
     setState(kDisconnecting);
-    // FIXME: shared_from_this()?
-    loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop, this));
+    if (canRunInLoop())
+    {
+      shutdownInLoop();
+    }
+    else
+    {
+      runOrdered(std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+    }
   }
 }
 
 void TcpConnection::shutdownInLoop()
 {
-  loop_->assertInLoopThread();
-  if (!channel_->isWriting())
+  if (!getLoop()->isInLoopThread())
+  {
+    getLoop()->runInLoop(std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+    return;
+  }
+  if (!channel_->isWriting() && !writeThrottled_)
   {
     // we are not writing
     socket_->shutdownWrite();
@@ -208,7 +411,7 @@ void TcpConnection::forceClose()
   if (state_ == kConnected || state_ == kDisconnecting)
   {
     setState(kDisconnecting);
-    loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    runOrdered(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
   }
 }
 
@@ -217,7 +420,7 @@ void TcpConnection::forceCloseWithDelay(double seconds)
   if (state_ == kConnected || state_ == kDisconnecting)
   {
     setState(kDisconnecting);
-    loop_->runAfter(
+    getLoop()->runAfter(
         seconds,
         makeWeakCallback(shared_from_this(),
                          &TcpConnection::forceClose));  // not forceCloseInLoop to avoid race condition
@@ -226,7 +429,11 @@ void TcpConnection::forceCloseWithDelay(double seconds)
 
 void TcpConnection::forceCloseInLoop()
 {
-  loop_->assertInLoopThread();
+  if (!getLoop()->isInLoopThread())
+  {
+    getLoop()->runInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    return;
+  }
   if (state_ == kConnected || state_ == kDisconnecting)
   {
     // as if we received 0 byte in handleRead();
@@ -256,112 +463,651 @@ void TcpConnection::setTcpNoDelay(bool on)
   socket_->setTcpNoDelay(on);
 }
 
-void TcpConnection::startRead()
+void TcpConnection::setEdgeTriggered(bool on)
 {
-  loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, this));
+  assert(state_ == kConnecting);
+  cold_->edgeTriggered = on;
+  channel_->setEdgeTriggered(on && getLoop()->supportsEdgeTriggered());
 }
 
-void TcpConnection::startReadInLoop()
+bool TcpConnection::isEdgeTriggered() const
+{
+  return cold_->edgeTriggered;
+}
+
+void TcpConnection::setSocketProfile(const SocketProfile& profile)
+{
+  assert(state_ == kConnecting);
+  socket_->applyConnectionProfile(profile, !cold_->localAddr.isUnix());
+  notSentLowat_ = cold_->localAddr.isUnix() ? 0 : profile.notSentLowat;
+  quickAck_ = !cold_->localAddr.isUnix() && profile.quickAck;
+}
+
+void TcpConnection::startRead()
 {
-  loop_->assertInLoopThread();
-  if (!reading_ || !channel_->isReading())
+  if (canRunInLoop())
   {
-    channel_->enableReading();
-    reading_ = true;
+    startReadInLoop();
   }
+  else
+  {
+    runOrdered(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+  }
+}
+
+void TcpConnection::startReadInLoop()
+{
+  getLoop()->assertInLoopThread();
+  reading_ = true;
+  updateReadInterest();
 }
 
 void TcpConnection::stopRead()
 {
-  loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, this));
+  if (canRunInLoop())
+  {
+    stopReadInLoop();
+  }
+  else
+  {
+    runOrdered(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+  }
 }
 
 void TcpConnection::stopReadInLoop()
 {
-  loop_->assertInLoopThread();
-  if (reading_ || channel_->isReading())
+  getLoop()->assertInLoopThread();
+  reading_ = false;
+  updateReadInterest();
+}
+
+void TcpConnection::updateReadInterest()
+{
+  bool wanted = reading_ && readBlocks_ == 0 && !readThrottled_;
+  if (wanted && !channel_->isReading())
+  {
+    channel_->enableReading();
+  }
+  else if (!wanted && channel_->isReading())
   {
     channel_->disableReading();
-    reading_ = false;
+  }
+}
+
+void TcpConnection::setFlowControl(size_t highMark, size_t lowMark,
+                                   const TcpConnectionPtr& source)
+{
+  getLoop()->assertInLoopThread();
+  assert(lowMark < highMark);
+  if (backlogged_)
+  {
+    setBacklogged(false);  // release the old source
+  }
+  flowHighMark_ = highMark;
+  flowLowMark_ = lowMark;
+  if (source)
+  {
+    cold_->flowSource = source;
+  }
+  else
+  {
+    cold_->flowSource = shared_from_this();
+  }
+}
+
+// in the loop of the source, which may differ from ours
+void TcpConnection::blockReadingInLoop(bool on)
+{
+  if (!getLoop()->isInLoopThread())
+  {
+    getLoop()->runInLoop(std::bind(&TcpConnection::blockReadingInLoop, shared_from_this(), on));
+    return;
+  }
+  if (on && readBlocks_++ == 0)
+  {
+    ++cold_->numReadPauses;
+    cold_->readPausedSince = Timestamp::now();
+  }
+  else if (!on && --readBlocks_ == 0)
+  {
+    cold_->readPausedMicroSeconds += Timestamp::now().microSecondsSinceEpoch()
+                               - cold_->readPausedSince.microSecondsSinceEpoch();
+  }
+  assert(readBlocks_ >= 0);
+  if (state_ == kConnected || state_ == kDisconnecting)
+  {
+    updateReadInterest();
+  }
+}
+
+void TcpConnection::setBacklogged(bool on)
+{
+  assert(backlogged_ != on);
+  backlogged_ = on;
+  LOG_TRACE << "TcpConnection::setBacklogged [" << name() << "] " << on
+            << " output " << outputBytes();
+  TcpConnectionPtr source(cold_->flowSource.lock());
+  if (source)  // else the source is gone, nothing to pause
+  {
+    source->blockReadingInLoop(on);
+  }
+}
+
+void TcpConnection::setRateLimit(const RateLimit& limit)
+{
+  rateLimiter_.reset(limit.limited() ? new RateLimiter(limit) : NULL);
+}
+
+void TcpConnection::setSharedRateLimiters(const std::shared_ptr<const LoopRateLimiters>& limiters)
+{
+  cold_->loopRateLimiters = limiters;
+  updateSharedRateLimiter(getLoop());
+}
+
+void TcpConnection::updateSharedRateLimiter(EventLoop* loop)
+{
+  sharedRateLimiter_.reset();
+  if (cold_->loopRateLimiters)
+  {
+    auto it = cold_->loopRateLimiters->find(loop);
+    if (it != cold_->loopRateLimiters->end())
+    {
+      sharedRateLimiter_ = it->second;
+    }
+  }
+}
+
+double TcpConnection::readWait(Timestamp now)
+{
+  double wait = 0.0;
+  RateLimiter* limiters[] = { get_pointer(rateLimiter_), get_pointer(sharedRateLimiter_) };
+  for (RateLimiter* limiter : limiters)
+  {
+    if (!limiter)
+      continue;
+    TokenBucket* buckets[] = { &limiter->readBytes(), &limiter->messages() };
+    for (TokenBucket* bucket : buckets)
+    {
+      if (bucket->limited())
+      {
+        bucket->available(now);
+        wait = std::max(wait, bucket->secondsUntil(1.0));
+      }
+    }
+  }
+  return wait;
+}
+
+double TcpConnection::chargeRead(size_t bytes, Timestamp now)
+{
+  RateLimiter* limiters[] = { get_pointer(rateLimiter_), get_pointer(sharedRateLimiter_) };
+  for (RateLimiter* limiter : limiters)
+  {
+    if (limiter)
+    {
+      limiter->readBytes().take(static_cast<double>(bytes));
+      limiter->messages().take(1.0);
+    }
+  }
+  return readWait(now);
+}
+
+double TcpConnection::writeWait(Timestamp now, size_t pending)
+{
+  double wait = 0.0;
+  RateLimiter* limiters[] = { get_pointer(rateLimiter_), get_pointer(sharedRateLimiter_) };
+  for (RateLimiter* limiter : limiters)
+  {
+    TokenBucket* bucket = limiter ? &limiter->writeBytes() : NULL;
+    if (bucket && bucket->limited())
+    {
+      bucket->available(now);
+      double need = std::min(static_cast<double>(std::min(pending, kWriteQuantum)),
+                             bucket->burst());
+      wait = std::max(wait, bucket->secondsUntil(std::max(need, 1.0)));
+    }
+  }
+  return wait;
+}
+
+size_t TcpConnection::writeAllowance(size_t wanted, Timestamp now)
+{
+  double allowed = static_cast<double>(wanted);
+  RateLimiter* limiters[] = { get_pointer(rateLimiter_), get_pointer(sharedRateLimiter_) };
+  for (RateLimiter* limiter : limiters)
+  {
+    if (limiter && limiter->writeBytes().limited())
+    {
+      allowed = std::min(allowed, std::max(limiter->writeBytes().available(now), 0.0));
+    }
+  }
+  return static_cast<size_t>(allowed);
+}
+
+void TcpConnection::chargeWrite(size_t bytes)
+{
+  RateLimiter* limiters[] = { get_pointer(rateLimiter_), get_pointer(sharedRateLimiter_) };
+  for (RateLimiter* limiter : limiters)
+  {
+    if (limiter)
+    {
+      limiter->writeBytes().take(static_cast<double>(bytes));
+    }
+  }
+}
+
+void TcpConnection::throttleRead(double seconds)
+{
+  assert(!readThrottled_);
+  readThrottled_ = true;
+  ++cold_->numReadThrottles;
+  updateReadInterest();
+  getLoop()->runAfter(seconds, makeWeakCallback(shared_from_this(), &TcpConnection::resumeRead));
+}
+
+void TcpConnection::throttleWrite(double seconds)
+{
+  assert(!writeThrottled_ && !channel_->isWriting());
+  writeThrottled_ = true;
+  ++cold_->numWriteThrottles;
+  getLoop()->runAfter(seconds, makeWeakCallback(shared_from_this(), &TcpConnection::resumeWrite));
+}
+
+void TcpConnection::resumeRead()
+{
+  if (!getLoop()->isInLoopThread())
+  {
+    // the timer stayed on the loop we migrated from
+    getLoop()->runInLoop(std::bind(&TcpConnection::resumeRead, shared_from_this()));
+    return;
+  }
+  readThrottled_ = false;
+  if (state_ != kConnected && state_ != kDisconnecting)
+  {
+    return;
+  }
+  double wait = readWait(getLoop()->now());
+  if (wait > 0.0)
+  {
+    // the shared limiter was drained by others meanwhile
+    throttleRead(wait);
+  }
+  else
+  {
+    updateReadInterest();
+  }
+}
+
+void TcpConnection::resumeWrite()
+{
+  if (!getLoop()->isInLoopThread())
+  {
+    getLoop()->runInLoop(std::bind(&TcpConnection::resumeWrite, shared_from_this()));
+    return;
+  }
+  writeThrottled_ = false;
+  if (state_ != kConnected && state_ != kDisconnecting)
+  {
+    return;
+  }
+  double wait = writeWait(getLoop()->now(), outputBytes());
+  if (wait > 0.0)
+  {
+    throttleWrite(wait);
+  }
+  else if (outputBytes() > 0)
+  {
+    channel_->enableWriting();
+  }
+  else if (state_ == kDisconnecting)
+  {
+    shutdownInLoop();
+  }
+}
+
+Buffer* TcpConnection::inputBuffer()
+{
+  return acquire(&inputBuffer_);
+}
+
+Buffer* TcpConnection::outputBuffer()
+{
+  return acquire(&outputBuffer_);
+}
+
+Buffer* TcpConnection::acquire(std::unique_ptr<Buffer>* buf)
+{
+  if (!*buf)
+  {
+    *buf = getLoop()->bufferPool()->get();
+  }
+  return buf->get();
+}
+
+void TcpConnection::reclaimBuffer(std::unique_ptr<Buffer>* buf)
+{
+  if (*buf)
+  {
+    getLoop()->bufferPool()->reclaim(buf);
+  }
+}
+
+bool TcpConnection::canRunInLoop() const
+{
+  return getLoop()->isInLoopThread() && !orderedQueued_.load(std::memory_order_relaxed);
+}
+
+void TcpConnection::runOrdered(const Functor& cb)
+{
+  {
+  MutexLockGuard lock(cold_->orderedMutex);
+  cold_->ordered.push_back(cb);
+  if (orderedQueued_.load(std::memory_order_relaxed))
+  {
+    return;  // the drain in flight takes it
+  }
+  orderedQueued_.store(true, std::memory_order_relaxed);
+  }
+  // no drain in flight, so no migration either: getLoop() is stable
+  getLoop()->queueInLoop(std::bind(&TcpConnection::drainOrdered, shared_from_this()));
+}
+
+// At most one drain is in flight, it runs in the loop that owns us and
+// moves with us when one of its calls is migrateInLoop().
+void TcpConnection::drainOrdered()
+{
+  getLoop()->assertInLoopThread();
+  std::vector<Functor> calls;
+  {
+  MutexLockGuard lock(cold_->orderedMutex);
+  calls.swap(cold_->ordered);
+  }
+  for (size_t i = 0; i < calls.size(); ++i)
+  {
+    if (!getLoop()->isInLoopThread())
+    {
+      // migrated by calls[i-1], the rest goes first on the new loop
+      {
+      MutexLockGuard lock(cold_->orderedMutex);
+      cold_->ordered.insert(cold_->ordered.begin(), calls.begin() + i, calls.end());
+      }
+      getLoop()->queueInLoop(std::bind(&TcpConnection::drainOrdered, shared_from_this()));
+      return;
+    }
+    calls[i]();
+  }
+  {
+  MutexLockGuard lock(cold_->orderedMutex);
+  if (cold_->ordered.empty())
+  {
+    orderedQueued_.store(false, std::memory_order_relaxed);
+    return;
+  }
+  }
+  getLoop()->queueInLoop(std::bind(&TcpConnection::drainOrdered, shared_from_this()));
+}
+
+void TcpConnection::queueOnOwnLoop(const Functor& cb)
+{
+  getLoop()->queueInLoop(std::bind(&TcpConnection::runOnOwnLoop, shared_from_this(), cb));
+}
+
+void TcpConnection::runOnOwnLoop(const Functor& cb)
+{
+  if (!getLoop()->isInLoopThread())
+  {
+    // a migrateInLoop() ran first in the same batch, follow the connection
+    getLoop()->runInLoop(std::bind(&TcpConnection::runOnOwnLoop, shared_from_this(), cb));
+    return;
+  }
+  cb();
+}
+
+void TcpConnection::migrateTo(EventLoop* loop, const ConnectionCallback& cb)
+{
+  assert(loop != NULL);
+  // always queued, even in the loop thread: let everything already
+  // queued for us finish first, so callbacks keep their order.
+  runOrdered(std::bind(&TcpConnection::migrateInLoop, shared_from_this(), loop, cb));
+}
+
+// The calls queued behind us in runOrdered() follow to the new loop,
+// after attachInLoop(), see drainOrdered().
+void TcpConnection::migrateInLoop(EventLoop* loop, const ConnectionCallback& cb)
+{
+  getLoop()->assertInLoopThread();
+  if (state_ != kConnected && state_ != kDisconnecting)
+  {
+    LOG_WARN << "TcpConnection::migrateInLoop [" << name()
+             << "] - not migrating in state " << stateToString();
+    return;
+  }
+  if (loop == getLoop())
+  {
+    if (cb) cb(shared_from_this());
+    return;
+  }
+
+  LOG_DEBUG << "TcpConnection::migrateInLoop [" << name() << "] fd="
+            << socket_->fd() << " from loop " << getLoop() << " to " << loop;
+  // bytes arriving from now on wait in the socket until attachInLoop(),
+  // inputBuffer_ and outputBuffer_ simply move along with this object,
+  // and go to the pool of the new loop once drained.
+  channel_->disableAll();
+  channel_->remove();
+  channel_.reset(new Channel(loop, socket_->fd()));
+  channel_->setEdgeTriggered(cold_->edgeTriggered && loop->supportsEdgeTriggered());
+  setChannelHandler();
+  // never charge the limiter of the old loop from the new one
+  updateSharedRateLimiter(loop);
+  ++cold_->numMigrations;
+  loop_.store(loop, std::memory_order_release);
+  loop->runInLoop(
+      std::bind(&TcpConnection::attachInLoop, shared_from_this(), cb));
+}
+
+void TcpConnection::attachInLoop(const ConnectionCallback& cb)
+{
+  getLoop()->assertInLoopThread();
+  if (state_ == kConnected || state_ == kDisconnecting)
+  {
+    updateReadInterest();
+    if (outputBytes() > 0 && !channel_->isWriting() && !writeThrottled_)
+    {
+      channel_->enableWriting();
+    }
+    if (cold_->migratedCallback) cold_->migratedCallback(shared_from_this());
+    if (cb) cb(shared_from_this());
   }
 }
 
 void TcpConnection::connectEstablished()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   assert(state_ == kConnecting);
   setState(kConnected);
-  channel_->tie(shared_from_this());
+  // alive till connectDestroyed(), so events need no tie() guard
+  self_ = shared_from_this();
   channel_->enableReading();
 
-  connectionCallback_(shared_from_this());
+  cold_->connectionCallback(self_);
 }
 
 void TcpConnection::connectDestroyed()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   if (state_ == kConnected)
   {
     setState(kDisconnected);
     channel_->disableAll();
 
-    connectionCallback_(shared_from_this());
+    cold_->connectionCallback(self_);
   }
   channel_->remove();
+  // the caller holds another reference, this does not delete us yet
+  self_.reset();
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
-  loop_->assertInLoopThread();
-  int savedErrno = 0;
-  ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-  if (n > 0)
+  getLoop()->assertInLoopThread();
+  // edge-triggered: read till EAGAIN, EPOLLIN comes once per burst
+  int rounds = channel_->isEdgeTriggered() ? kEdgeTriggeredRounds : 1;
+  for (int i = 0; i < rounds; ++i)
+  {
+    int savedErrno = 0;
+    ssize_t n = acquire(&inputBuffer_)->readFd(channel_->fd(), &savedErrno);
+    if (n > 0)
+    {
+      if (quickAck_)
+      {
+        // the kernel leaves quick ACK mode on its own, set it again
+        socket_->setQuickAck(true);
+      }
+      messageCallback_(self_, inputBuffer_.get(), receiveTime);
+      reclaimBuffer(&inputBuffer_);
+      if (rateLimited() && !readThrottled_ && state_ == kConnected)
+      {
+        double wait = chargeRead(n, receiveTime);
+        if (wait > 0.0)
+        {
+          throttleRead(wait);
+        }
+      }
+      if (!channel_->isReading())
+      {
+        return;  // stopped, throttled or closed
+      }
+    }
+    else if (n == 0)
+    {
+      reclaimBuffer(&inputBuffer_);
+      handleClose();
+      return;
+    }
+    else
+    {
+      reclaimBuffer(&inputBuffer_);
+      if (channel_->isEdgeTriggered() && savedErrno == EAGAIN)
+      {
+        return;
+      }
+      errno = savedErrno;
+      LOG_SYSERR << "TcpConnection::handleRead";
+      handleError();
+      return;
+    }
+  }
+  if (channel_->isEdgeTriggered())
   {
-    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    // out of budget with input left, let the other channels go first
+    getLoop()->queueInLoop(std::bind(&TcpConnection::continueReading, shared_from_this()));
   }
-  else if (n == 0)
+}
+
+void TcpConnection::continueReading()
+{
+  if (!getLoop()->isInLoopThread())
   {
-    handleClose();
+    // queued before a migrateTo() moved us, follow the connection
+    getLoop()->runInLoop(std::bind(&TcpConnection::continueReading, shared_from_this()));
+    return;
   }
-  else
+  if ((state_ == kConnected || state_ == kDisconnecting) && channel_->isReading())
   {
-    errno = savedErrno;
-    LOG_SYSERR << "TcpConnection::handleRead";
-    handleError();
+    handleRead(getLoop()->now());
   }
 }
 
 void TcpConnection::handleWrite()
 {
-  loop_->assertInLoopThread();
-  if (channel_->isWriting())
+  getLoop()->assertInLoopThread();
+  if (awaitingLowat_)
   {
-    ssize_t n = sockets::write(channel_->fd(),
-                               outputBuffer_.peek(),
-                               outputBuffer_.readableBytes());
-    if (n > 0)
+    // with TCP_NOTSENT_LOWAT writable means the kernel queue is short again
+    awaitingLowat_ = false;
+    channel_->disableWriting();
+    queueOnOwnLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    if (state_ == kDisconnecting)
+    {
+      shutdownInLoop();
+    }
+  }
+  else if (channel_->isWriting())
+  {
+    // edge-triggered: write till the socket is full, EPOLLOUT comes once
+    // per drain of the send buffer
+    int rounds = channel_->isEdgeTriggered() ? kEdgeTriggeredRounds : 1;
+    for (int i = 0; i < rounds; ++i)
     {
-      outputBuffer_.retrieve(n);
-      if (outputBuffer_.readableBytes() == 0)
+      size_t wanted = outputBytes();
+      if (rateLimited())
+      {
+        Timestamp now(getLoop()->now());
+        double wait = writeWait(now, wanted);
+        if (wait > 0.0)
+        {
+          channel_->disableWriting();
+          throttleWrite(wait);
+          return;
+        }
+        wanted = writeAllowance(wanted, now);
+      }
+      ssize_t n = sockets::write(channel_->fd(),
+                                 outputBuffer_ ? outputBuffer_->peek() : NULL,
+                                 wanted);
+      if (n <= 0)
+      {
+        if (!channel_->isEdgeTriggered() || errno != EWOULDBLOCK)
+        {
+          LOG_SYSERR << "TcpConnection::handleWrite";
+        }
+        // if (state_ == kDisconnecting)
+        // {
+        //   shutdownInLoop();
+        // }
+        return;
+      }
+
+      outputBuffer_->retrieve(n);
+      reclaimBuffer(&outputBuffer_);
+      if (rateLimited())
+      {
+        chargeWrite(n);
+      }
+      if (backlogged_ && outputBytes() <= flowLowMark_)
+      {
+        setBacklogged(false);
+      }
+      if (outputBytes() == 0 && notSentLowat_ > 0
+          && writeCompleteCallback_)
+      {
+        awaitingLowat_ = true;  // keep polling for writable
+        channel_->rearm();      // the kernel queue may be short already
+        return;
+      }
+      else if (outputBytes() == 0)
       {
         channel_->disableWriting();
         if (writeCompleteCallback_)
         {
-          loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+          queueOnOwnLoop(std::bind(writeCompleteCallback_, shared_from_this()));
         }
         if (state_ == kDisconnecting)
         {
           shutdownInLoop();
         }
+        return;
+      }
+      else if (static_cast<size_t>(n) < wanted)
+      {
+        return;  // the socket is full, wait for EPOLLOUT
       }
     }
-    else
+    if (channel_->isEdgeTriggered())
     {
-      LOG_SYSERR << "TcpConnection::handleWrite";
-      // if (state_ == kDisconnecting)
-      // {
-      //   shutdownInLoop();
-      // }
+      // out of budget with the socket still writable, no edge will come
+      getLoop()->queueInLoop(std::bind(&TcpConnection::continueWriting, shared_from_this()));
     }
   }
   else
@@ -371,25 +1117,44 @@ void TcpConnection::handleWrite()
   }
 }
 
+void TcpConnection::continueWriting()
+{
+  if (!getLoop()->isInLoopThread())
+  {
+    // queued before a migrateTo() moved us, follow the connection
+    getLoop()->runInLoop(std::bind(&TcpConnection::continueWriting, shared_from_this()));
+    return;
+  }
+  if ((state_ == kConnected || state_ == kDisconnecting)
+      && channel_->isWriting() && !awaitingLowat_)
+  {
+    handleWrite();
+  }
+}
+
 void TcpConnection::handleClose()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   LOG_TRACE << "fd = " << channel_->fd() << " state = " << stateToString();
   assert(state_ == kConnected || state_ == kDisconnecting);
   // we don't close fd, leave it to dtor, so we can find leaks easily.
   setState(kDisconnected);
   channel_->disableAll();
+  if (backlogged_)
+  {
+    setBacklogged(false);  // the source must not wait for us forever
+  }
 
   TcpConnectionPtr guardThis(shared_from_this());
-  connectionCallback_(guardThis);
+  cold_->connectionCallback(guardThis);
   // must be the last line
-  closeCallback_(guardThis);
+  cold_->closeCallback(guardThis);
 }
 
 void TcpConnection::handleError()
 {
   int err = sockets::getSocketError(channel_->fd());
-  LOG_ERROR << "TcpConnection::handleError [" << name_
+  LOG_ERROR << "TcpConnection::handleError [" << name()
             << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
 
@@ -0,0 +1,93 @@
+#include <muduo/net/TcpInfoSampler.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/TcpConnection.h>
+
+#include <algorithm>
+
+using namespace muduo;
+using namespace muduo::net;
+
+TcpInfoSampler::TcpInfoSampler(EventLoop* loop, double intervalSeconds, int slices)
+  : loop_(CHECK_NOTNULL(loop)),
+    slices_(slices),
+    cursor_(0),
+    slice_(0)
+{
+  assert(intervalSeconds > 0.0 && slices_ > 0);
+  loop_->assertInLoopThread();
+  timer_ = loop_->runEvery(intervalSeconds / slices_,
+                           std::bind(&TcpInfoSampler::sampleSlice, this));
+}
+
+TcpInfoSampler::~TcpInfoSampler()
+{
+  loop_->assertInLoopThread();
+  loop_->cancel(timer_);
+}
+
+void TcpInfoSampler::add(const TcpConnectionPtr& conn)
+{
+  loop_->assertInLoopThread();
+  assert(conn->getLoop() == loop_);
+  Entry entry;
+  entry.conn = conn;
+  entry.migrations = conn->numMigrations();
+  entry.totalRetrans = 0;
+  TcpStats stats;
+  if (conn->getTcpStats(&stats))
+  {
+    entry.totalRetrans = stats.totalRetrans;
+  }
+  entries_.push_back(entry);
+}
+
+// ceil(remaining / slices left) entries, so the pass ends with its last slice
+void TcpInfoSampler::sampleSlice()
+{
+  size_t remaining = entries_.size() - cursor_;
+  size_t slicesLeft = static_cast<size_t>(slices_ - slice_);
+  size_t end = cursor_ + (remaining + slicesLeft - 1) / slicesLeft;
+  TcpStats stats;
+  while (cursor_ < end && cursor_ < entries_.size())
+  {
+    Entry& entry = entries_[cursor_];
+    TcpConnectionPtr conn(entry.conn.lock());
+    // moved away, maybe back again: added anew by the sampler of its loop
+    if (!conn || conn->getLoop() != loop_
+        || conn->numMigrations() != entry.migrations
+        || conn->disconnected() || !conn->getTcpStats(&stats))
+    {
+      // swap with the last, which is not sampled in this pass yet
+      entry = entries_.back();
+      entries_.pop_back();
+      --end;
+      continue;
+    }
+
+    int64_t retransmits = stats.totalRetrans - entry.totalRetrans;
+    entry.totalRetrans = stats.totalRetrans;
+    ++current_.connections;
+    current_.retransmits += retransmits;
+    current_.rttUsSum += stats.rttUs;
+    current_.maxRttUs = std::max(current_.maxRttUs, stats.rttUs);
+    current_.notSentBytes += stats.notSentBytes;
+    if (sampleCallback_)
+    {
+      sampleCallback_(conn, stats);
+    }
+    ++cursor_;
+  }
+
+  if (++slice_ == slices_)
+  {
+    current_.completed = Timestamp::now();
+    lastPass_ = current_;
+    current_ = Summary();
+    cursor_ = 0;
+    slice_ = 0;
+    LOG_TRACE << "TcpInfoSampler pass of " << lastPass_.connections
+              << " connections, " << lastPass_.retransmits << " retransmits";
+  }
+}
@@ -4,30 +4,91 @@
 #include <muduo/net/Acceptor.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/EventLoopThreadPool.h>
+#include <muduo/net/Socket.h>
 #include <muduo/net/SocketsOps.h>
 #include<map>
 
-#include <stdio.h>  // snprintf
-
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+// registers connections with the sampler of the loop they are in, when
+// established and after each migration; bound without the TcpServer,
+// which may be gone by the time a connection it made is destroyed.
+void addToSampler(const std::shared_ptr<const TcpInfoSampler::LoopSamplers>& samplers,
+                  const TcpConnectionPtr& conn)
+{
+  auto it = samplers->find(conn->getLoop());
+  if (it != samplers->end())
+  {
+    // in the sampler's loop, which destroys it
+    std::shared_ptr<TcpInfoSampler> sampler(it->second.lock());
+    if (sampler)
+    {
+      sampler->add(conn);
+    }
+  }
+}
+
+void onConnectionSampled(const std::shared_ptr<const TcpInfoSampler::LoopSamplers>& samplers,
+                         const ConnectionCallback& cb,
+                         const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    addToSampler(samplers, conn);
+  }
+  cb(conn);
+}
+
+void establishConnections(const std::vector<TcpConnectionPtr>& conns)
+{
+  for (const TcpConnectionPtr& conn : conns)
+  {
+    conn->connectEstablished();
+  }
+}
+
+}
+
 TcpServer::TcpServer(EventLoop* loop,
                      const InetAddress& listenAddr,
                      const string& nameArg,
                      Option option)
   : loop_(CHECK_NOTNULL(loop)),
+    listenAddr_(listenAddr),
     ipPort_(listenAddr.toIpPort()),
     name_(nameArg),
-    acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+    connNamePrefix_(std::make_shared<const string>(name_ + "-" + ipPort_)),
+    // N listeners on one unix path would unlink each other's socket file
+    option_(option == kReusePortPerLoop && listenAddr.isUnix()
+            ? kExclusiveListenerPerLoop : option),
+    cpuSteering_(false),
+    acceptBatch_(Acceptor::kDefaultAcceptBatch),
+    edgeTriggered_(false),
+    perLoopConnections_(false),
+    acceptor_(option == kReusePortPerLoop || option == kExclusiveListenerPerLoop ? NULL
+              : new Acceptor(loop, listenAddr, option == kReusePort)),
     threadPool_(new EventLoopThreadPool(loop, name_)),
+    samplingInterval_(0.0),
     connectionCallback_(defaultConnectionCallback),
-    messageCallback_(defaultMessageCallback),
-    nextConnId_(1),
-    connections_(std::map<string,TcpConnectionPtr>())
+    messageCallback_(defaultMessageCallback)
 {
-  acceptor_->setNewConnectionCallback(
-      std::bind(&TcpServer::newConnection, this, _1, _2));
+  nextConnId_.getAndSet(1);
+  if (option_ != option)
+  {
+    LOG_WARN << "TcpServer::TcpServer [" << name_ << "] - " << ipPort_
+             << " cannot be bound per loop, using kExclusiveListenerPerLoop";
+  }
+  if (acceptor_)
+  {
+    acceptor_->setNewConnectionCallback(
+        std::bind(&TcpServer::newConnection, this, _1, _2));
+    acceptor_->setAcceptBatchCallback(
+        std::bind(&TcpServer::flushPendingConnections, this));
+  }
 }
 
 TcpServer::~TcpServer()
@@ -35,12 +96,45 @@ TcpServer::~TcpServer()
   loop_->assertInLoopThread();
   LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
 
-  for (auto& item : connections_)
+  // an Acceptor must die in its own loop, stop accepting before
+  // tearing down the connections.
+  for (auto& acceptor : loopAcceptors_)
+  {
+    acceptor->getLoop()->runInLoopAndWait([&] { acceptor.reset(); });
+  }
+  for (auto& item : samplers_)
   {
-    TcpConnectionPtr conn(item.second);
-    item.second.reset();
+    item.first->runInLoopAndWait([&] { item.second.reset(); });
+  }
+
+  ConnectionMap connections;
+  {
+  MutexLockGuard lock(mutex_);
+  connections.swap(connections_);
+  }
+  auto destroy = [](uint64_t, TcpConnectionPtr& item) {
+    TcpConnectionPtr conn(item);
+    item.reset();
     conn->getLoop()->runInLoop(
       std::bind(&TcpConnection::connectDestroyed, conn));
+  };
+  connections.forEach(destroy);
+  if (started_.get() && !perLoopConnections_)
+  {
+    // a loop still in the functors of a runInLoopAndWait() above would
+    // see the pool's quit() before these, wait till each one has run them
+    for (EventLoop* ioLoop : threadPool_->getAllLoops())
+    {
+      ioLoop->runInLoopAndWait([] {});
+    }
+  }
+  for (auto& item : loopConnections_)
+  {
+    item.first->runInLoopAndWait([&] {
+      ConnectionMap loopConnections;
+      loopConnections.swap(*item.second);
+      loopConnections.forEach(destroy);
+    });
   }
 }
 
@@ -50,60 +144,359 @@ void TcpServer::setThreadNum(int numThreads)
   threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setAdmissionControl(const AdmissionControl::Options& options)
+{
+  assert(!started_.get());
+  admission_.reset(new AdmissionControl(options));
+}
+
+void TcpServer::setRateLimit(const RateLimit& perConnection, const RateLimit& perLoop)
+{
+  assert(!started_.get());
+  connectionRateLimit_ = perConnection;
+  loopRateLimit_ = perLoop;
+}
+
+void TcpServer::setTcpInfoSampling(double intervalSeconds,
+                                   const TcpInfoSampler::SampleCallback& cb)
+{
+  assert(!started_.get());
+  assert(intervalSeconds > 0.0);
+  samplingInterval_ = intervalSeconds;
+  sampleCallback_ = cb;
+}
+
+const TcpInfoSampler* TcpServer::tcpInfoSampler(EventLoop* ioLoop) const
+{
+  auto it = samplers_.find(ioLoop);
+  return it != samplers_.end() ? get_pointer(it->second) : NULL;
+}
+
+void TcpServer::startSamplers()
+{
+  std::shared_ptr<TcpInfoSampler::LoopSamplers> loopSamplers(
+      new TcpInfoSampler::LoopSamplers);
+  for (EventLoop* ioLoop : threadPool_->getAllLoops())
+  {
+    std::shared_ptr<TcpInfoSampler>& sampler = samplers_[ioLoop];
+    ioLoop->runInLoopAndWait([&] {
+      sampler.reset(new TcpInfoSampler(ioLoop, samplingInterval_));
+      sampler->setSampleCallback(sampleCallback_);
+    });
+    (*loopSamplers)[ioLoop] = sampler;
+  }
+  loopSamplers_ = loopSamplers;
+}
+
 void TcpServer::start()
 {
   if (started_.getAndSet(1) == 0)
   {
     threadPool_->start(threadInitCallback_);
+    if (perLoopConnections_)
+    {
+      for (EventLoop* ioLoop : threadPool_->getAllLoops())
+      {
+        loopConnections_[ioLoop].reset(new ConnectionMap);
+      }
+    }
+    if (loopRateLimit_.limited())
+    {
+      std::shared_ptr<TcpConnection::LoopRateLimiters> limiters(
+          new TcpConnection::LoopRateLimiters);
+      for (EventLoop* ioLoop : threadPool_->getAllLoops())
+      {
+        (*limiters)[ioLoop].reset(new RateLimiter(loopRateLimit_));
+      }
+      loopRateLimiters_ = limiters;
+    }
+    if (samplingInterval_ > 0.0)
+    {
+      startSamplers();
+    }
+    if (admission_ && admission_->options().maxLoopLagSeconds > 0.0)
+    {
+      for (EventLoop* ioLoop : threadPool_->getAllLoops())
+      {
+        ioLoop->runInLoop(std::bind(&EventLoop::setLagTracking, ioLoop, true));
+      }
+    }
+
+    if (acceptor_)
+    {
+      assert(!acceptor_->listenning());
+      acceptor_->setAcceptBatch(acceptBatch_);
+      acceptor_->acceptSocket()->applyListenerProfile(profile_, !listenAddr_.isUnix());
+      loop_->runInLoop(
+          std::bind(&Acceptor::listen, get_pointer(acceptor_)));
+    }
+    else
+    {
+      startLoopAcceptors();
+    }
+  }
+}
 
-    assert(!acceptor_->listenning());
-    loop_->runInLoop(
-        std::bind(&Acceptor::listen, get_pointer(acceptor_)));
+void TcpServer::startLoopAcceptors()
+{
+  loop_->assertInLoopThread();
+  assert(loopAcceptors_.empty());
+  std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+  InetAddress listenAddr(listenAddr_);
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    EventLoop* ioLoop = loops[i];
+    std::unique_ptr<Acceptor> acceptor;
+    if (option_ == kExclusiveListenerPerLoop)
+    {
+      acceptor.reset(i == 0 ? new Acceptor(ioLoop, listenAddr, false)
+                            : new Acceptor(ioLoop, loopAcceptors_[0]->listenFd()));
+      acceptor->setEpollExclusive(true);
+    }
+    else
+    {
+      acceptor.reset(new Acceptor(ioLoop, listenAddr, true));
+    }
+    acceptor->setNewConnectionCallback(
+        std::bind(&TcpServer::newConnectionInLoop, this, get_pointer(acceptor), _1, _2));
+    acceptor->setAcceptBatch(acceptBatch_);
+    acceptor->acceptSocket()->applyListenerProfile(profile_, !listenAddr_.isUnix());
+    if (i == 0)
+    {
+      // with port 0, make the others join the port the kernel picked.
+      listenAddr = InetAddress::localAddressOf(acceptor->listenFd());
+    }
+    // listen one by one, reuseport group order must follow loop order
+    // for the CPU steering program.
+    ioLoop->runInLoopAndWait(std::bind(&Acceptor::listen, get_pointer(acceptor)));
+    loopAcceptors_.push_back(std::move(acceptor));
+  }
+
+  if (cpuSteering_ && option_ == kReusePortPerLoop)
+  {
+    int groupSize = static_cast<int>(loopAcceptors_.size());
+    if (!loopAcceptors_[0]->acceptSocket()->attachReusePortCpuSteering(groupSize))
+    {
+      for (int i = 0; i < groupSize; ++i)
+      {
+        loopAcceptors_[i]->acceptSocket()->setIncomingCpu(i);
+      }
+    }
   }
+  LOG_INFO << "TcpServer::startLoopAcceptors [" << name_ << "] - "
+           << loopAcceptors_.size() << " per-loop acceptors";
 }
 
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
   loop_->assertInLoopThread();
   EventLoop* ioLoop = threadPool_->getNextLoop();
-  char buf[64];
-  snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-  ++nextConnId_;
-  string connName = name_ + buf;
+  TcpConnectionPtr conn(createConnection(get_pointer(acceptor_), ioLoop, sockfd, peerAddr));
+  if (conn)
+  {
+    pendingConnections_.push_back(conn);
+  }
+}
+
+void TcpServer::flushPendingConnections()
+{
+  loop_->assertInLoopThread();
+  // one queueInLoop() (and at most one wakeup) per I/O loop for the
+  // whole batch, keeping accept order within each loop.
+  std::vector<TcpConnectionPtr> pending;
+  pending.swap(pendingConnections_);
+  std::vector<TcpConnectionPtr> batch;
+  for (size_t i = 0; i < pending.size(); ++i)
+  {
+    if (!pending[i])
+    {
+      continue;  // already taken by an earlier batch
+    }
+    EventLoop* ioLoop = pending[i]->getLoop();
+    batch.clear();
+    for (size_t j = i; j < pending.size(); ++j)
+    {
+      if (pending[j] && pending[j]->getLoop() == ioLoop)
+      {
+        batch.push_back(pending[j]);
+        pending[j].reset();
+      }
+    }
+    // binding this is safe with per-loop tables only: ~TcpServer()
+    // waits for every loop, so batches queued before it run first.
+    EventLoop::Functor establish = perLoopConnections_
+        ? EventLoop::Functor(std::bind(&TcpServer::registerConnections, this, batch))
+        : EventLoop::Functor(std::bind(&establishConnections, batch));
+    if (ioLoop->isInLoopThread())
+    {
+      establish();
+    }
+    else
+    {
+      ioLoop->queueInLoop(establish);
+    }
+  }
+}
+
+void TcpServer::newConnectionInLoop(Acceptor* acceptor, int sockfd, const InetAddress& peerAddr)
+{
+  EventLoop* ioLoop = acceptor->getLoop();
+  ioLoop->assertInLoopThread();
+  TcpConnectionPtr conn(createConnection(acceptor, ioLoop, sockfd, peerAddr));
+  if (conn && perLoopConnections_)
+  {
+    registerConnection(conn);
+  }
+  else if (conn)
+  {
+    conn->connectEstablished();
+  }
+}
+
+void TcpServer::registerConnections(const std::vector<TcpConnectionPtr>& conns)
+{
+  for (const TcpConnectionPtr& conn : conns)
+  {
+    registerConnection(conn);
+  }
+}
 
+void TcpServer::registerConnection(const TcpConnectionPtr& conn)
+{
+  conn->getLoop()->assertInLoopThread();
+  // the loop owns its table, no lock
+  (*loopConnections_.at(conn->getLoop()))[conn->id()] = conn;
+  numConnections_.increment();
+  conn->connectEstablished();
+}
+
+TcpConnectionPtr TcpServer::createConnection(Acceptor* acceptor, EventLoop* ioLoop,
+                                             int sockfd, const InetAddress& peerAddr)
+{
+  if (admission_)
+  {
+    AdmissionControl::Verdict verdict = admission_->admit(peerAddr, ioLoop);
+    if (verdict != AdmissionControl::kAdmit)
+    {
+      LOG_DEBUG << "TcpServer::createConnection [" << name_
+                << "] - refused " << peerAddr.toIpPort() << " verdict " << verdict;
+      sockets::close(sockfd);
+      if (verdict == AdmissionControl::kRejectLoopLag
+          && admission_->options().pauseAcceptOnLag)
+      {
+        acceptor->pauseFor(admission_->options().pauseSeconds);
+      }
+      return TcpConnectionPtr();
+    }
+  }
+
+  // no per-connection string, conn->name() is formatted if ever asked
+  uint64_t id = static_cast<uint64_t>(nextConnId_.getAndAdd(1));
   LOG_INFO << "TcpServer::newConnection [" << name_
-           << "] - new connection [" << connName
-           << "] from " << peerAddr.toIpPort();
-  InetAddress localAddr(sockets::getLocalAddr(sockfd));
+           << "] - new connection #" << id
+           << " from " << peerAddr.toIpPort();
+  InetAddress localAddr(InetAddress::localAddressOf(sockfd));
   TcpConnectionPtr conn(new TcpConnection(ioLoop,
-                                          connName,
+                                          id,
+                                          connNamePrefix_,
                                           sockfd,
                                           localAddr,
                                           peerAddr));
-  connections_[connName] = conn;
-  conn->setConnectionCallback(connectionCallback_);
+  conn->setSocketProfile(profile_);
+  conn->setEdgeTriggered(edgeTriggered_);
+  conn->setRateLimit(connectionRateLimit_);
+  if (loopRateLimiters_)
+  {
+    conn->setSharedRateLimiters(loopRateLimiters_);
+  }
+  if (!perLoopConnections_)
+  {
+    MutexLockGuard lock(mutex_);
+    connections_[id] = conn;
+    numConnections_.increment();
+  }
+  if (!loopSamplers_)
+  {
+    conn->setConnectionCallback(connectionCallback_);
+  }
+  else
+  {
+    conn->setConnectionCallback(
+        std::bind(&onConnectionSampled, loopSamplers_, connectionCallback_, _1));
+    conn->setMigratedCallback(std::bind(&addToSampler, loopSamplers_, _1));
+  }
   conn->setMessageCallback(messageCallback_);
   conn->setWriteCompleteCallback(writeCompleteCallback_);
-  conn->setCloseCallback(
-      std::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
-  ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+  if (perLoopConnections_)
+  {
+    conn->setCloseCallback(
+        std::bind(&TcpServer::removeConnectionFromLoop, this, ioLoop, _1)); // FIXME: unsafe
+  }
+  else
+  {
+    conn->setCloseCallback(
+        std::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
+  }
+  return conn;
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr& conn)
 {
+  if (perLoopAccept())
+  {
+    // the base loop takes no part in per-loop modes
+    removeConnectionInLoop(conn);
+    return;
+  }
   // FIXME: unsafe
   loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
 }
 
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
 {
-  loop_->assertInLoopThread();
+  if (!perLoopAccept())
+  {
+    loop_->assertInLoopThread();
+  }
   LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_
-           << "] - connection " << conn->name();
-  size_t n = connections_.erase(conn->name());
+           << "] - connection #" << conn->id();
+  size_t n = 0;
+  {
+  MutexLockGuard lock(mutex_);
+  n = connections_.erase(conn->id());
+  }
   (void)n;
   assert(n == 1);
+  numConnections_.decrement();
+  if (admission_)
+  {
+    admission_->release(conn->peerAddress());
+  }
   EventLoop* ioLoop = conn->getLoop();
   ioLoop->queueInLoop(
       std::bind(&TcpConnection::connectDestroyed, conn));
 }
+
+void TcpServer::removeConnectionFromLoop(EventLoop* ownerLoop, const TcpConnectionPtr& conn)
+{
+  if (!ownerLoop->isInLoopThread())
+  {
+    // migrated away, the entry is still in the table of ownerLoop
+    ownerLoop->runInLoop(
+        std::bind(&TcpServer::removeConnectionFromLoop, this, ownerLoop, conn));
+    return;
+  }
+  LOG_INFO << "TcpServer::removeConnectionFromLoop [" << name_
+           << "] - connection #" << conn->id();
+  size_t n = loopConnections_.at(ownerLoop)->erase(conn->id());
+  (void)n;
+  assert(n == 1);
+  numConnections_.decrement();
+  if (admission_)
+  {
+    admission_->release(conn->peerAddress());
+  }
+  // not destroyed right here, we are inside its handleClose()
+  conn->getLoop()->queueInLoop(
+      std::bind(&TcpConnection::connectDestroyed, conn));
+}
@@ -0,0 +1,123 @@
+#include <muduo/net/TimerHeap.h>
+#include <muduo/net/Timer.h>
+
+#include <algorithm>
+
+#include <assert.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+TimerHeap::TimerHeap()
+{
+}
+
+void TimerHeap::place(size_t index, const Node& node)
+{
+  heap_[index] = node;
+  node.timer->setPosition(kBucket, index);
+}
+
+void TimerHeap::insert(Timer* timer)
+{
+  assert(timer->bucket() < 0);
+  Node node = { timer->expiration().microSecondsSinceEpoch(), timer };
+  heap_.push_back(node);
+  siftUp(heap_.size() - 1, node);
+}
+
+// moves the hole at index up till node fits
+void TimerHeap::siftUp(size_t index, Node node)
+{
+  while (index > 0)
+  {
+    size_t parent = (index - 1) / kArity;
+    if (heap_[parent].when <= node.when)
+    {
+      break;
+    }
+    place(index, heap_[parent]);
+    index = parent;
+  }
+  place(index, node);
+}
+
+// moves the hole at index down till node fits
+void TimerHeap::siftDown(size_t index, Node node)
+{
+  size_t n = heap_.size();
+  for (;;)
+  {
+    size_t first = index * kArity + 1;
+    if (first >= n)
+    {
+      break;
+    }
+    size_t last = std::min(first + kArity, n);
+    size_t least = first;
+    for (size_t child = first + 1; child < last; ++child)
+    {
+      if (heap_[child].when < heap_[least].when)
+      {
+        least = child;
+      }
+    }
+    if (node.when <= heap_[least].when)
+    {
+      break;
+    }
+    place(index, heap_[least]);
+    index = least;
+  }
+  place(index, node);
+}
+
+void TimerHeap::removeAt(size_t index)
+{
+  heap_[index].timer->setPosition(-1, 0);
+  Node last = heap_.back();
+  heap_.pop_back();
+  if (index < heap_.size())
+  {
+    if (index > 0 && last.when < heap_[(index - 1) / kArity].when)
+    {
+      siftUp(index, last);
+    }
+    else
+    {
+      siftDown(index, last);
+    }
+  }
+}
+
+bool TimerHeap::erase(Timer* timer)
+{
+  if (timer->bucket() != kBucket)
+  {
+    return false;
+  }
+  size_t index = timer->position();
+  assert(index < heap_.size() && heap_[index].timer == timer);
+  removeAt(index);
+  return true;
+}
+
+void TimerHeap::popExpired(Timestamp now, std::vector<Timer*>* expired)
+{
+  int64_t limit = now.microSecondsSinceEpoch();
+  while (!heap_.empty() && heap_[0].when <= limit)
+  {
+    expired->push_back(heap_[0].timer);
+    removeAt(0);
+  }
+}
+
+void TimerHeap::takeAll(std::vector<Timer*>* timers)
+{
+  for (const Node& node : heap_)
+  {
+    node.timer->setPosition(-1, 0);
+    timers->push_back(node.timer);
+  }
+  heap_.clear();
+}
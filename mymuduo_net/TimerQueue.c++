@@ -3,8 +3,13 @@
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/Timer.h>
 #include <muduo/net/TimerId.h>
+#include <muduo/net/TimingWheel.h>
 
+#include <algorithm>
+
+#include <sys/prctl.h>
 #include <sys/timerfd.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 namespace muduo
@@ -26,10 +31,10 @@ int createTimerfd()
   return timerfd;
 }
 
-struct timespec howMuchTimeFromNow(Timestamp when)
+struct timespec howMuchTimeFromNow(Timestamp when, Timestamp now)
 {
   int64_t microseconds = when.microSecondsSinceEpoch()
-                         - Timestamp::now().microSecondsSinceEpoch();
+                         - now.microSecondsSinceEpoch();
   if (microseconds < 100)
   {
     microseconds = 100;
@@ -53,14 +58,14 @@ void readTimerfd(int timerfd, Timestamp now)
   }
 }
 
-void resetTimerfd(int timerfd, Timestamp expiration)
+void resetTimerfd(int timerfd, Timestamp expiration, Timestamp now)
 {
   // wake up loop by timerfd_settime()
   struct itimerspec newValue;
   struct itimerspec oldValue;
   bzero(&newValue, sizeof newValue);
   bzero(&oldValue, sizeof oldValue);
-  newValue.it_value = howMuchTimeFromNow(expiration);
+  newValue.it_value = howMuchTimeFromNow(expiration, now);
   int ret = ::timerfd_settime(timerfd, 0, &newValue, &oldValue);
   if (ret)
   {
@@ -78,24 +83,90 @@ using namespace muduo::net::detail;
 //-------------------TimerQueue的实现：-------------------
 TimerQueue::TimerQueue(EventLoop* loop)
   : loop_(loop), //当前TimerQueue所属的EventLoop
-    timerfd_(createTimerfd()),//每个TimerQueue对应一个timerfd
-    timerfdChannel_(loop, timerfd_),//对应一个Channel
-    timers_(),//std::set , 根据到期时间排好序的Timers
-    activeTimers_(),
-    callingExpiredTimers_(false)
+    timerfd_(-1),//每个TimerQueue对应一个timerfd，或者不用timerfd
+    heap_(),//按到期时间排列的4叉堆
+    slackMicroSeconds_(0),
+    callingExpiredTimers_(false),
+    numChunks_(0)
 {
-  timerfdChannel_.setReadCallback(
-      std::bind(&TimerQueue::handleRead, this));//设置timerfd可读的回调函数，其内容时处理每个到期Timer
-  // we are always reading the timerfd, we disarm it with timerfd_settime.
-  timerfdChannel_.enableReading();
+  //环境变量只决定默认方式，EventLoop::setTimerPollTimeout()可以逐个loop改
+  if (::getenv("MUDUO_TIMER_POLL_TIMEOUT"))
+  {
+    dropThreadTimerSlack(true);
+  }
+  else
+  {
+    openTimerfd();
+  }
+  if (const char* tickMs = ::getenv("MUDUO_TIMER_WHEEL_TICK_MS"))
+  {
+    int64_t tick = static_cast<int64_t>(::atof(tickMs) * 1000);
+    if (tick > 0)
+    {
+      wheel_.reset(new TimingWheel(tick, loop_->clockNow()));
+    }
+  }
 }
 
 TimerQueue::~TimerQueue()
 {
-  timerfdChannel_.disableAll();
-  timerfdChannel_.remove();
-  ::close(timerfd_);
-  //因为timers_和ActiveTimers_中的Timer都使用了shared_ptr，因此不需要手动delete
+  if (timerfd_ >= 0)
+  {
+    closeTimerfd();
+  }
+  //所有Timer都在对象池里，随块一起析构
+  for (int i = 0; i < numChunks_; ++i)
+  {
+    for (int j = 0; j < kChunkSize; ++j)
+    {
+      chunks_[i][j].~Timer();
+    }
+    ::operator delete(chunks_[i]);
+  }
+}
+
+//从对象池取一个Timer，没有空闲的就再分配一块
+Timer* TimerQueue::newTimer(TimerCallback cb, Timestamp when, double interval)
+{
+  Timer* timer = NULL;
+  {
+  MutexLockGuard lock(mutex_);
+  if (freeSlots_.empty())
+  {
+    if (numChunks_ == kMaxChunks)
+    {
+      LOG_FATAL << "TimerQueue::newTimer() too many timers";
+    }
+    Timer* chunk = static_cast<Timer*>(::operator new(sizeof(Timer) * kChunkSize));
+    int base = numChunks_ << kChunkBits;
+    for (int j = 0; j < kChunkSize; ++j)
+    {
+      new (&chunk[j]) Timer(base + j);
+    }
+    chunks_[numChunks_++] = chunk;
+    freeSlots_.reserve(numChunks_ * kChunkSize);
+    for (int slot = base + kChunkSize - 1; slot >= base; --slot)
+    {
+      freeSlots_.push_back(slot);
+    }
+  }
+  timer = timerOf(freeSlots_.back());
+  freeSlots_.pop_back();
+  }
+  timer->init(std::move(cb), when, interval);
+  return timer;
+}
+
+Timer* TimerQueue::timerOf(int slot) const
+{
+  return &chunks_[slot >> kChunkBits][slot & (kChunkSize - 1)];
+}
+
+void TimerQueue::deleteTimer(Timer* timer)
+{
+  timer->release();
+  MutexLockGuard lock(mutex_);
+  freeSlots_.push_back(timer->slot());
 }
 
 //--------------------TimerQueue的接口1，添加定时器
@@ -103,145 +174,292 @@ TimerId TimerQueue::addTimer(TimerCallback cb,
                              Timestamp when,
                              double interval)
 {
-    //构造一个Timer对象，并使用智能指针指向它
-    std::shared_ptr<Timer> timer=std::make_shared<Timer>(std::move(cb), when, interval);
+  Timer* timer = newTimer(std::move(cb), when, interval);
+  //先生成id：其他线程里，timer可能在addTimer返回前就已到期并被回收
+  TimerId timerId(timer->slot(), timer->generation());
     /*****线程安全的异步调用，
      * 当前线程t1把当前定时器Timer加入到线程t2的任务队列中，其中t2是loop对象所在的IO线程
      * 这样t2异步的调用传进去的回调函数：addTimerInLoop()
      * 其中t1,t2可能不相等
-     * 这避免了对临界资源---timers_的锁的使用
-     * 因为最终操作timers_的都是loop所在的那个IO线程，实现了线程同步********/
-  loop_->runInLoop(
-      std::bind(&TimerQueue::addTimerInLoop, this, timer));//注册异步调用的回调函数
-  return TimerId(timer, timer->sequence());
+     * 这避免了对临界资源---heap_的锁的使用
+     * 因为最终操作heap_的都是loop所在的那个IO线程，实现了线程同步********/
+  if (loop_->isInLoopThread())
+  {
+    addTimerInLoop(timer);//直接调用，省掉构造std::function
+  }
+  else
+  {
+    loop_->queueInLoop(
+        std::bind(&TimerQueue::addTimerInLoop, this, timer));//注册异步调用的回调函数
+  }
+  return timerId;
 }
 //------------------------TimerQueue的接口2：取消指定id的定时器
 void TimerQueue::cancel(TimerId timerId)
 {
-  loop_->runInLoop(
-      std::bind(&TimerQueue::cancelInLoop, this, timerId));
+  if (loop_->isInLoopThread())
+  {
+    cancelInLoop(timerId);
+  }
+  else
+  {
+    loop_->queueInLoop(
+        std::bind(&TimerQueue::cancelInLoop, this, timerId));
+  }
 }
 //------------------------内部函数实现：
 
-//把addTimer new出来的Timer添加进loop事件循环中
+//把addTimer取出的Timer添加进loop事件循环中
 //如果当前线程不是拥有loop的线程，那就是由loop所在的IO线程在loop()中调用，否则就是由当前线程通过addTimer()
-void TimerQueue::addTimerInLoop(std::shared_ptr<Timer> timer)
+void TimerQueue::addTimerInLoop(Timer* timer)
 {
+  if (timer->canceled())
+  {
+    //还没加进来就被取消了
+    deleteTimer(timer);
+    return;
+  }
   bool earliestChanged = this->insert(timer);
 
   if (earliestChanged)
   {
-    resetTimerfd(timerfd_, timer->expiration());
+    armTimerfd(earliest());
   }
 }
-//insert:把传进来的Timer添加进timers_
-bool TimerQueue::insert(std::shared_ptr<Timer>timer)
+
+//按最早的定时器加上slack设定timerfd，slack窗口里到期的定时器在同一次唤醒里处理
+void TimerQueue::armTimerfd(Timestamp earliest)
 {
-  assert(timers_.size() == activeTimers_.size());
-  bool earliestChanged = false;
-  Timestamp when = timer->expiration();
-  TimerList::iterator it = timers_.begin();
-  if (it == timers_.end() || when < it->first)
-  {
-    earliestChanged = true;
-  }
+  armedAt_ = Timestamp(earliest.microSecondsSinceEpoch() + slackMicroSeconds_);
+  if (timerfd_ >= 0)
   {
-       timers_.emplace(Entry(when, timer));
+    resetTimerfd(timerfd_, armedAt_, loop_->clockNow());//与判断到期用同一个时钟
   }
+}
+
+//when加上slack之后还不早于当前的设定，就不必重设timerfd
+bool TimerQueue::needsRearm(Timestamp when) const
+{
+  return !armedAt_.valid()
+      || when.microSecondsSinceEpoch() + slackMicroSeconds_ < armedAt_.microSecondsSinceEpoch();
+}
+
+Timestamp TimerQueue::earliest() const
+{
+  return wheel_ ? wheel_->nextWakeup() : heap_.earliest();
+}
+
+//insert:把传进来的Timer添加进heap_
+bool TimerQueue::insert(Timer* timer)
+{
+  if (wheel_)
   {
-       activeTimers_.emplace(ActiveTimer(timer, timer->sequence()));
+    if (wheel_->empty())
+    {
+      wheel_->skipTo(loop_->clockNow());
+    }
+    wheel_->insert(timer);
+    return needsRearm(wheel_->nextWakeup());
   }
-
-  assert(timers_.size() == activeTimers_.size());
-  return earliestChanged;
+  heap_.insert(timer);
+  return needsRearm(timer->expiration());
 }
 //移除Timer
 //如果当前线程不是拥有loop的线程，那就是由loop所在的IO线程在loop()中调用，否则就是由当前线程通过addTimer()
 void TimerQueue::cancelInLoop(TimerId timerId)
 {
-  ActiveTimer timer(timerId.timer_, timerId.sequence_);
-  ActiveTimerSet::iterator it = activeTimers_.find(timer);
-  if (it != activeTimers_.end())
-      //先判断要删除的Timer是否处于loop监听
+  if (timerId.slot_ < 0)
   {
-    timers_.erase(Entry(it->first->expiration(), it->first));
-    activeTimers_.erase(it);
-    //不需要delete Timer资源，因为两个集合里都erase掉了对应的智能指针，不再有指针指向它就没了
+    return;
   }
-  else if (callingExpiredTimers_)
+  Timer* timer = timerOf(timerId.slot_);
+  if (timer->generation() != timerId.generation_)
   {
-    cancelingTimers_.insert(timer);
+    return;  // already fired or canceled, the slot may be in use again
+  }
+  bool erased = wheel_ ? wheel_->erase(timer) : heap_.erase(timer);
+  if (erased)
+  {
+    //timerfd保持不变，提前醒来只是发现没有到期的定时器
+    deleteTimer(timer);
+  }
+  else
+  {
+    //正在执行回调，或者还在去addTimerInLoop()的路上
+    timer->setCanceled();
   }
 }
-std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now)
-{
-  std::vector<Entry> expired;
-  /****因为智能指针重载了比较运算符
-   * ，所以就像普通指针运用比较运算一样，智能指针比较大小也是比的包含的原始指针的地址的高低
-   * 所以这里不需要重载set的比较函数****/
-  Entry sentry(now, std::shared_ptr<Timer>(reinterpret_cast<Timer*>(UINTPTR_MAX)));
-  //先比较时间再比较地址，end是第一个严格大于now的定时器的位置
-  TimerList::iterator end = timers_.lower_bound(sentry);//end之前就是所有已到期定时器，下面遍历他们
-  std::copy(timers_.begin(), end, back_inserter(expired));
-  timers_.erase(timers_.begin(), end);
 
-  for (std::vector<Entry>::iterator it = expired.begin();
-      it != expired.end(); ++it)
+void TimerQueue::getExpired(Timestamp now, std::vector<Timer*>* expired)
+{
+  if (wheel_)
   {
-    ActiveTimer timer(it->second, it->second->sequence());
-    activeTimers_.erase(timer);
+    wheel_->advance(now, expired);
+  }
+  else
+  {
+    heap_.popExpired(now, expired);
   }
-
-  return expired;
 }
 
-void TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now)
+void TimerQueue::reset(const std::vector<Timer*>& expired, Timestamp now)
 {
   Timestamp nextExpire;
 
-  for (std::vector<Entry>::const_iterator it = expired.begin();
-      it != expired.end(); ++it)
+  for (Timer* timer : expired)
   {
-    ActiveTimer timer(it->second, it->second->sequence());
-    if (it->second->repeat()
-        && cancelingTimers_.find(timer) == cancelingTimers_.end())
+    if (timer->repeat() && !timer->canceled())
     {
-      it->second->restart(now);
-      insert(it->second);
+      timer->restart(now);
+      insert(timer);
     }
     else
     {
+      deleteTimer(timer);
     }
   }
 
-  if (!timers_.empty())
+  nextExpire = earliest();
+
+  armedAt_ = Timestamp::invalid();
+  if (nextExpire.valid())
   {
-    nextExpire = timers_.begin()->second->expiration();
+    armTimerfd(nextExpire);
   }
+}
 
-  if (nextExpire.valid())
+void TimerQueue::setSlack(int64_t slackMicroSeconds)
+{
+  loop_->assertInLoopThread();
+  slackMicroSeconds_ = std::max<int64_t>(slackMicroSeconds, 0);
+}
+
+void TimerQueue::setTimingWheel(int64_t tickMicroSeconds)
+{
+  loop_->assertInLoopThread();
+  std::vector<Timer*> timers;
+  if (wheel_)
+  {
+    wheel_->takeAll(&timers);
+    wheel_.reset();
+  }
+  else
+  {
+    heap_.takeAll(&timers);
+  }
+  if (tickMicroSeconds > 0)
+  {
+    wheel_.reset(new TimingWheel(tickMicroSeconds, loop_->clockNow()));
+  }
+  armedAt_ = Timestamp::invalid();
+  for (Timer* timer : timers)
+  {
+    insert(timer);
+  }
+  Timestamp next = earliest();
+  if (next.valid())
+  {
+    armTimerfd(next);
+  }
+}
+
+void TimerQueue::openTimerfd()
+{
+  timerfd_ = createTimerfd();
+  timerfdChannel_.reset(new Channel(loop_, timerfd_));//对应一个Channel
+  timerfdChannel_->setReadCallback(
+      std::bind(&TimerQueue::handleRead, this));//设置timerfd可读的回调函数，其内容时处理每个到期Timer
+  // we are always reading the timerfd, we disarm it with timerfd_settime.
+  timerfdChannel_->enableReading();
+}
+
+void TimerQueue::closeTimerfd()
+{
+  timerfdChannel_->disableAll();
+  timerfdChannel_->remove();
+  timerfdChannel_.reset();
+  ::close(timerfd_);
+  timerfd_ = -1;
+}
+
+// poll timeouts get the thread's timer slack, 50us by default, which
+// timerfd does not. The loop thread only sleeps in poll, drop it.
+void TimerQueue::dropThreadTimerSlack(bool drop)
+{
+  //0恢复线程默认的timer slack
+  ::prctl(PR_SET_TIMERSLACK, drop ? 1UL : 0UL, 0UL, 0UL, 0UL);
+}
+
+void TimerQueue::setPollTimeout(bool on)
+{
+  loop_->assertInLoopThread();
+  assert(!callingExpiredTimers_);
+  if (on == !usesTimerfd())
+  {
+    return;
+  }
+  if (on)
   {
-    resetTimerfd(timerfd_, nextExpire);
+    closeTimerfd();//armedAt_不变，pollTimeout()接着用
+  }
+  else
+  {
+    openTimerfd();
+    if (armedAt_.valid())
+    {
+      resetTimerfd(timerfd_, armedAt_, loop_->clockNow());
+    }
+  }
+  dropThreadTimerSlack(on);
+}
+
+//----------------------不用timerfd时，由EventLoop::loop()计算超时时间并调用processTimers()
+int64_t TimerQueue::pollTimeout(Timestamp now, int64_t maxMicroSeconds) const
+{
+  if (!armedAt_.valid())
+  {
+    return maxMicroSeconds;
+  }
+  int64_t timeout = armedAt_.microSecondsSinceEpoch() - now.microSecondsSinceEpoch();
+  return std::max<int64_t>(0, std::min(timeout, maxMicroSeconds));
+}
+
+void TimerQueue::processTimers(Timestamp now)
+{
+  assert(timerfd_ < 0);
+  if (armedAt_.valid() && !(now < armedAt_))
+  {
+    runExpired(now);
   }
 }
 
 //----------------------timerfd可读的回调函数：
 void TimerQueue::handleRead()
 {
-  Timestamp now(Timestamp::now());
+  Timestamp now(loop_->now());//poll返回时缓存的时间
   readTimerfd(timerfd_, now);
+  runExpired(now);
+}
 
-  std::vector<Entry> expired = getExpired(now);
+void TimerQueue::runExpired(Timestamp now)
+{
+  std::vector<Timer*> expired;
+  expired.swap(expired_);
+  getExpired(now, &expired);
 
   callingExpiredTimers_ = true;
-  cancelingTimers_.clear();
   // safe to callback outside critical section
-  for (std::vector<Entry>::iterator it = expired.begin();
-      it != expired.end(); ++it)
+  for (Timer* timer : expired)
   {
-    it->second->run();
+    //同一批里被前面的回调取消的，不再执行
+    if (!timer->canceled())
+    {
+      timer->run();
+    }
   }
   callingExpiredTimers_ = false;
 
   reset(expired, now);
+  expired.clear();
+  expired_.swap(expired);
 }
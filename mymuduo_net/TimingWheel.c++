@@ -0,0 +1,192 @@
+#include <muduo/net/TimingWheel.h>
+#include <muduo/net/Timer.h>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+inline uint64_t rotateRight(uint64_t bits, int n)
+{
+  return n == 0 ? bits : (bits >> n) | (bits << (64 - n));
+}
+
+}
+
+TimingWheel::TimingWheel(int64_t tickMicroSeconds, Timestamp now)
+  : tickMicroSeconds_(tickMicroSeconds),
+    current_(now.microSecondsSinceEpoch() / tickMicroSeconds),
+    size_(0)
+{
+  assert(tickMicroSeconds_ > 0);
+  ::memset(occupied_, 0, sizeof occupied_);
+}
+
+TimingWheel::~TimingWheel()
+{
+}
+
+// rounds up, so a timer never fires before its expiration
+int64_t TimingWheel::tickOf(Timestamp when) const
+{
+  return (when.microSecondsSinceEpoch() + tickMicroSeconds_ - 1) / tickMicroSeconds_;
+}
+
+void TimingWheel::insert(Timer* timer)
+{
+  assert(timer->bucket() < 0);
+  place(timer, std::max(tickOf(timer->expiration()), current_ + 1));
+  ++size_;
+}
+
+// tick >= current_, only cascade() places a timer on current_ itself
+void TimingWheel::place(Timer* timer, int64_t tick)
+{
+  int64_t delta = tick - current_;
+  int level = 0;
+  while (level < kLevels - 1 && delta >= (int64_t(1) << (kLevelBits * (level + 1))))
+  {
+    ++level;
+  }
+  int64_t horizon = int64_t(1) << (kLevelBits * kLevels);
+  if (delta >= horizon)
+  {
+    // too far away, park at the end of the top level and place again on cascade
+    tick = current_ + horizon - 1;
+  }
+  int index = static_cast<int>((tick >> (kLevelBits * level)) & (kSlotsPerLevel - 1));
+  int bucket = level * kSlotsPerLevel + index;
+  std::vector<Timer*>& slot = slots_[bucket];
+  timer->setPosition(bucket, slot.size());
+  slot.push_back(timer);
+  occupied_[level] |= uint64_t(1) << index;
+}
+
+void TimingWheel::skipTo(Timestamp now)
+{
+  assert(size_ == 0);
+  current_ = std::max(current_, now.microSecondsSinceEpoch() / tickMicroSeconds_);
+}
+
+bool TimingWheel::erase(Timer* timer)
+{
+  int bucket = timer->bucket();
+  if (bucket < 0)
+  {
+    return false;
+  }
+  std::vector<Timer*>& slot = slots_[bucket];
+  size_t pos = timer->position();
+  assert(pos < slot.size() && slot[pos] == timer);
+  if (pos + 1 != slot.size())
+  {
+    slot[pos] = slot.back();
+    slot[pos]->setPosition(bucket, pos);
+  }
+  slot.pop_back();
+  if (slot.empty())
+  {
+    occupied_[bucket / kSlotsPerLevel] &= ~(uint64_t(1) << (bucket % kSlotsPerLevel));
+  }
+  clearPosition(timer);
+  --size_;
+  return true;
+}
+
+void TimingWheel::clearPosition(Timer* timer)
+{
+  timer->setPosition(-1, 0);
+}
+
+// first tick after current_ on which a non-empty slot comes up,
+// a level 0 slot fires, a higher one cascades
+int64_t TimingWheel::nextTick() const
+{
+  int64_t next = INT64_MAX;
+  for (int level = 0; level < kLevels; ++level)
+  {
+    if (occupied_[level] == 0)
+    {
+      continue;
+    }
+    int shift = kLevelBits * level;
+    int64_t base = current_ >> shift;
+    int from = static_cast<int>((base + 1) & (kSlotsPerLevel - 1));
+    uint64_t bits = rotateRight(occupied_[level], from);
+    int64_t tick = (base + 1 + __builtin_ctzll(bits)) << shift;
+    next = std::min(next, tick);
+  }
+  return next;
+}
+
+Timestamp TimingWheel::nextWakeup() const
+{
+  if (size_ == 0)
+  {
+    return Timestamp::invalid();
+  }
+  return Timestamp(nextTick() * tickMicroSeconds_);
+}
+
+void TimingWheel::cascade(int level, int index)
+{
+  int bucket = level * kSlotsPerLevel + index;
+  std::vector<Timer*> timers;
+  timers.swap(slots_[bucket]);
+  occupied_[level] &= ~(uint64_t(1) << index);
+  for (Timer* timer : timers)
+  {
+    place(timer, std::max(tickOf(timer->expiration()), current_));
+  }
+}
+
+void TimingWheel::advance(Timestamp now, std::vector<Timer*>* expired)
+{
+  int64_t target = now.microSecondsSinceEpoch() / tickMicroSeconds_;
+  while (size_ > 0 && current_ < target)
+  {
+    // ticks in between have nothing to fire or cascade
+    current_ = std::min(nextTick(), target);
+    // coarse levels first, they may drop timers into the finer slots due now
+    for (int level = kLevels - 1; level > 0; --level)
+    {
+      int shift = kLevelBits * level;
+      if ((current_ & ((int64_t(1) << shift) - 1)) == 0)
+      {
+        cascade(level, static_cast<int>((current_ >> shift) & (kSlotsPerLevel - 1)));
+      }
+    }
+    int index = static_cast<int>(current_ & (kSlotsPerLevel - 1));
+    std::vector<Timer*>& slot = slots_[index];
+    for (Timer* timer : slot)
+    {
+      clearPosition(timer);
+      expired->push_back(timer);
+    }
+    size_ -= slot.size();
+    slot.clear();
+    occupied_[0] &= ~(uint64_t(1) << index);
+  }
+  current_ = std::max(current_, target);
+}
+
+void TimingWheel::takeAll(std::vector<Timer*>* timers)
+{
+  for (std::vector<Timer*>& slot : slots_)
+  {
+    for (Timer* timer : slot)
+    {
+      clearPosition(timer);
+      timers->push_back(timer);
+    }
+    slot.clear();
+  }
+  ::memset(occupied_, 0, sizeof occupied_);
+  size_ = 0;
+}
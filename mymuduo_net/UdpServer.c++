@@ -0,0 +1,69 @@
+#include <muduo/net/UdpServer.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThreadPool.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+UdpServer::UdpServer(EventLoop* loop,
+                     const InetAddress& listenAddr,
+                     const string& nameArg,
+                     const UdpSocket::Options& options)
+  : loop_(CHECK_NOTNULL(loop)),
+    listenAddr_(listenAddr),
+    name_(nameArg),
+    options_(options),
+    threadPool_(new EventLoopThreadPool(loop, name_))
+{
+}
+
+UdpServer::~UdpServer()
+{
+  loop_->assertInLoopThread();
+  LOG_TRACE << "UdpServer::~UdpServer [" << name_ << "] destructing";
+  // a UdpSocket must die in its own loop
+  for (auto& socket : sockets_)
+  {
+    socket->getLoop()->runInLoopAndWait([&] { socket.reset(); });
+  }
+}
+
+void UdpServer::setThreadNum(int numThreads)
+{
+  assert(0 <= numThreads);
+  threadPool_->setThreadNum(numThreads);
+}
+
+void UdpServer::start()
+{
+  loop_->assertInLoopThread();
+  if (started_.getAndSet(1) != 0)
+  {
+    return;
+  }
+  threadPool_->start(threadInitCallback_);
+
+  std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+  UdpSocket::Options options(options_);
+  options.reusePort = options.reusePort || loops.size() > 1;
+  InetAddress listenAddr(listenAddr_);
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    EventLoop* ioLoop = loops[i];
+    ioLoop->runInLoopAndWait([&] {
+      std::unique_ptr<UdpSocket> socket(new UdpSocket(ioLoop, listenAddr, options));
+      socket->setMessageCallback(messageCallback_);
+      socket->start();
+      sockets_.push_back(std::move(socket));
+    });
+    if (i == 0)
+    {
+      // with port 0, make the others join the port the kernel picked.
+      listenAddr = sockets_[0]->localAddress();
+    }
+  }
+  LOG_INFO << "UdpServer::start [" << name_ << "] - " << sockets_.size()
+           << " sockets on " << listenAddr.toIpPort();
+}
@@ -0,0 +1,325 @@
+#include <muduo/net/UdpSocket.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/SocketsOps.h>
+
+#include <algorithm>
+
+#include <errno.h>
+#include <netinet/udp.h>
+#include <string.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const size_t kControlSpace = CMSG_SPACE(sizeof(int));
+const size_t kMaxGroSize = 65535;
+// the kernel limits a GSO send to 64 segments and one IP datagram
+const size_t kMaxGsoSegments = 64;
+const size_t kMaxGsoBytes = 65507;
+
+bool wouldBlock(int savedErrno)
+{
+  return savedErrno == EAGAIN || savedErrno == EWOULDBLOCK;
+}
+
+}
+
+UdpSocket::UdpSocket(EventLoop* loop, const InetAddress& bindAddr,
+                     const Options& options)
+  : loop_(CHECK_NOTNULL(loop)),
+    options_(options),
+    socket_(sockets::createDgramNonblockingOrDie()),
+    channel_(loop, socket_.fd()),
+    gro_(false),
+    gso_(true),
+    bufferSize_(options.bufferSize),
+    numReceived_(0),
+    numBatches_(0),
+    numTruncated_(0),
+    numSendDropped_(0)
+{
+  assert(options_.batchSize > 0);
+  socket_.setReusePort(options_.reusePort);
+  socket_.bindAddress(bindAddr);
+  if (options_.gro)
+  {
+    int on = 1;
+    if (::setsockopt(fd(), SOL_UDP, UDP_GRO, &on, static_cast<socklen_t>(sizeof on)) == 0)
+    {
+      gro_ = true;
+      bufferSize_ = std::max(bufferSize_, kMaxGroSize);
+    }
+    else
+    {
+      LOG_SYSERR << "UdpSocket UDP_GRO";
+    }
+  }
+
+  size_t batchSize = static_cast<size_t>(options_.batchSize);
+  buffer_.resize(bufferSize_ * batchSize);
+  recvHdrs_.resize(batchSize);
+  recvIovs_.resize(batchSize);
+  recvAddrs_.resize(batchSize);
+  recvControls_.resize(kControlSpace * batchSize);
+  messages_.reserve(batchSize);
+  for (size_t i = 0; i < batchSize; ++i)
+  {
+    recvIovs_[i].iov_base = &buffer_[i * bufferSize_];
+    recvIovs_[i].iov_len = bufferSize_;
+    ::memset(&recvHdrs_[i], 0, sizeof recvHdrs_[i]);
+    recvHdrs_[i].msg_hdr.msg_iov = &recvIovs_[i];
+    recvHdrs_[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  channel_.setReadCallback(
+      std::bind(&UdpSocket::handleRead, this, _1));
+}
+
+UdpSocket::~UdpSocket()
+{
+  channel_.disableAll();
+  channel_.remove();
+}
+
+InetAddress UdpSocket::localAddress() const
+{
+  return InetAddress::localAddressOf(fd());
+}
+
+void UdpSocket::start()
+{
+  loop_->assertInLoopThread();
+  channel_.enableReading();
+}
+
+void UdpSocket::handleRead(Timestamp receiveTime)
+{
+  loop_->assertInLoopThread();
+  for (int i = 0; i < options_.maxBatchesPerRead; ++i)
+  {
+    int n = receiveBatch();
+    if (!messages_.empty() && messageCallback_)
+    {
+      messageCallback_(this, messages_.data(), messages_.size(), receiveTime);
+    }
+    if (n < options_.batchSize)
+    {
+      break;
+    }
+  }
+}
+
+// reads up to batchSize datagrams into messages_, returns how many
+int UdpSocket::receiveBatch()
+{
+  messages_.clear();
+  for (size_t i = 0; i < recvHdrs_.size(); ++i)
+  {
+    struct msghdr& hdr = recvHdrs_[i].msg_hdr;
+    hdr.msg_name = &recvAddrs_[i];
+    hdr.msg_namelen = static_cast<socklen_t>(sizeof recvAddrs_[i]);
+    hdr.msg_control = gro_ ? &recvControls_[i * kControlSpace] : NULL;
+    hdr.msg_controllen = gro_ ? kControlSpace : 0;
+    hdr.msg_flags = 0;
+  }
+
+  int n = ::recvmmsg(fd(), recvHdrs_.data(), static_cast<unsigned>(recvHdrs_.size()),
+                     MSG_DONTWAIT, NULL);
+  if (n < 0)
+  {
+    if (!wouldBlock(errno) && errno != EINTR)
+    {
+      LOG_SYSERR << "UdpSocket::receiveBatch";
+    }
+    return 0;
+  }
+
+  ++numBatches_;
+  numReceived_ += n;
+  for (int i = 0; i < n; ++i)
+  {
+    struct msghdr& hdr = recvHdrs_[i].msg_hdr;
+    if (hdr.msg_flags & MSG_TRUNC)
+    {
+      ++numTruncated_;
+      continue;
+    }
+    UdpMessage message = { static_cast<const char*>(recvIovs_[i].iov_base),
+                           recvHdrs_[i].msg_len,
+                           InetAddress(recvAddrs_[i]),
+                           0 };
+    if (gro_)
+    {
+      for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != NULL;
+           cmsg = CMSG_NXTHDR(&hdr, cmsg))
+      {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+        {
+          int segmentSize;
+          ::memcpy(&segmentSize, CMSG_DATA(cmsg), sizeof segmentSize);
+          if (static_cast<size_t>(segmentSize) < message.length)
+          {
+            message.segmentSize = static_cast<uint16_t>(segmentSize);
+          }
+        }
+      }
+    }
+    messages_.push_back(message);
+  }
+  return n;
+}
+
+size_t UdpSocket::send(const UdpMessage* messages, size_t count)
+{
+  loop_->assertInLoopThread();
+  sendHdrs_.resize(count);
+  sendIovs_.resize(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    sendIovs_[i].iov_base = const_cast<char*>(messages[i].data);
+    sendIovs_[i].iov_len = messages[i].length;
+    ::memset(&sendHdrs_[i], 0, sizeof sendHdrs_[i]);
+    struct msghdr& hdr = sendHdrs_[i].msg_hdr;
+    hdr.msg_name = const_cast<struct sockaddr*>(messages[i].peer.getSockAddr());
+    hdr.msg_namelen = messages[i].peer.sockLen();
+    hdr.msg_iov = &sendIovs_[i];
+    hdr.msg_iovlen = 1;
+  }
+  return sendBatch(sendHdrs_.data(), count);
+}
+
+// a datagram the kernel refuses is skipped, a full socket buffer drops the rest
+size_t UdpSocket::sendBatch(struct mmsghdr* hdrs, size_t count)
+{
+  size_t done = 0;
+  size_t sent = 0;
+  while (done < count)
+  {
+    int n = ::sendmmsg(fd(), hdrs + done, static_cast<unsigned>(count - done), 0);
+    if (n >= 0)
+    {
+      done += n;
+      sent += n;
+    }
+    else if (errno == EINTR)
+    {
+      continue;
+    }
+    else if (wouldBlock(errno))
+    {
+      break;
+    }
+    else
+    {
+      LOG_SYSERR << "UdpSocket::sendBatch";
+      ++done;
+    }
+  }
+  numSendDropped_ += count - sent;
+  return sent;
+}
+
+bool UdpSocket::send(const char* data, size_t length, const InetAddress& peer)
+{
+  loop_->assertInLoopThread();
+  ssize_t n = ::sendto(fd(), data, length, 0, peer.getSockAddr(), peer.sockLen());
+  if (n < 0)
+  {
+    if (!wouldBlock(errno))
+    {
+      LOG_SYSERR << "UdpSocket::send";
+    }
+    ++numSendDropped_;
+    return false;
+  }
+  return true;
+}
+
+bool UdpSocket::sendSegmented(const char* data, size_t length, uint16_t segmentSize,
+                              const InetAddress& peer)
+{
+  loop_->assertInLoopThread();
+  assert(segmentSize > 0);
+  if (length <= segmentSize)
+  {
+    return send(data, length, peer);
+  }
+
+  size_t offset = 0;
+  size_t chunkSize = std::min(kMaxGsoSegments, kMaxGsoBytes / segmentSize) * segmentSize;
+  while (gso_ && chunkSize > 0 && offset < length)
+  {
+    size_t chunk = std::min(chunkSize, length - offset);
+    if (sendGso(data + offset, chunk, segmentSize, peer.getSockAddrInet()))
+    {
+      offset += chunk;
+    }
+    else if (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP)
+    {
+      LOG_WARN << "UdpSocket::sendSegmented no UDP_SEGMENT, errno " << errno;
+      gso_ = false;
+    }
+    else
+    {
+      if (!wouldBlock(errno))
+      {
+        LOG_SYSERR << "UdpSocket::sendSegmented";
+      }
+      numSendDropped_ += (length - offset + segmentSize - 1) / segmentSize;
+      return false;
+    }
+  }
+
+  if (offset < length)
+  {
+    std::vector<UdpMessage> segments;
+    for (; offset < length; offset += segmentSize)
+    {
+      UdpMessage segment = { data + offset, std::min<size_t>(segmentSize, length - offset),
+                             peer, 0 };
+      segments.push_back(segment);
+    }
+    return send(segments.data(), segments.size()) == segments.size();
+  }
+  return true;
+}
+
+bool UdpSocket::sendGso(const char* data, size_t length, uint16_t segmentSize,
+                        const struct sockaddr_in& peer)
+{
+  struct iovec iov = { const_cast<char*>(data), length };
+  char control[CMSG_SPACE(sizeof(uint16_t))];
+  ::memset(control, 0, sizeof control);
+  struct msghdr hdr;
+  ::memset(&hdr, 0, sizeof hdr);
+  hdr.msg_name = const_cast<struct sockaddr_in*>(&peer);
+  hdr.msg_namelen = static_cast<socklen_t>(sizeof peer);
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+  hdr.msg_control = control;
+  hdr.msg_controllen = sizeof control;
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+  cmsg->cmsg_level = SOL_UDP;
+  cmsg->cmsg_type = UDP_SEGMENT;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+  ::memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof segmentSize);
+
+  ssize_t n;
+  do
+  {
+    n = ::sendmsg(fd(), &hdr, 0);
+  } while (n < 0 && errno == EINTR);
+  return n >= 0;
+}
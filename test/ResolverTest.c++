@@ -0,0 +1,210 @@
+// Resolver against a stand-in nameserver on a local UDP socket: the
+// answer, its TTL in the cache, the timeout of a name never answered,
+// and a lookup from another thread.
+//
+// usage: resolver_test
+
+#include <muduo/base/Logging.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/Resolver.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const char kName[] = "svc.test";
+const char kAddress[] = "10.0.0.1";
+const uint32_t kTtlSeconds = 1;
+const char kSilentName[] = "silent.test";
+
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  if (!ok)
+  {
+    ++failures;
+  }
+}
+
+// Answers A queries for kName from its own thread, ignores kSilentName.
+class StandInNameserver
+{
+ public:
+  StandInNameserver()
+    : sockfd_(::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)),
+      numAnswered_(0),
+      numIgnored_(0)
+  {
+    struct sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = static_cast<socklen_t>(sizeof addr);
+    if (sockfd_ < 0
+        || ::bind(sockfd_, reinterpret_cast<struct sockaddr*>(&addr), len) < 0
+        || ::getsockname(sockfd_, reinterpret_cast<struct sockaddr*>(&addr), &len) < 0)
+    {
+      LOG_SYSFATAL << "StandInNameserver";
+    }
+    address_ = InetAddress(addr);
+    thread_ = std::thread([this] { serve(); });
+  }
+
+  ~StandInNameserver()
+  {
+    ::shutdown(sockfd_, SHUT_RDWR);  // wakes up recvfrom()
+    thread_.join();
+    ::close(sockfd_);
+  }
+
+  const InetAddress& address() const { return address_; }
+  int numAnswered() const { return numAnswered_; }
+  int numIgnored() const { return numIgnored_; }
+
+ private:
+  void serve()
+  {
+    unsigned char packet[512];
+    for (;;)
+    {
+      struct sockaddr_in peer;
+      socklen_t peerLen = static_cast<socklen_t>(sizeof peer);
+      ssize_t n = ::recvfrom(sockfd_, packet, sizeof packet, 0,
+                             reinterpret_cast<struct sockaddr*>(&peer), &peerLen);
+      if (n <= 0)
+      {
+        return;
+      }
+      size_t end = 12;
+      string name;
+      while (end < static_cast<size_t>(n) && packet[end] != 0)
+      {
+        if (!name.empty())
+        {
+          name.push_back('.');
+        }
+        name.append(reinterpret_cast<const char*>(packet) + end + 1, packet[end]);
+        end += 1 + packet[end];
+      }
+      end += 1 + 4;  // root label, type, class
+      if (end > static_cast<size_t>(n))
+      {
+        continue;
+      }
+      if (name != kName)
+      {
+        ++numIgnored_;
+        continue;
+      }
+      ++numAnswered_;
+
+      string response(reinterpret_cast<const char*>(packet), end);
+      response[2] = static_cast<char>(0x81);  // response, recursion desired
+      response[3] = static_cast<char>(0x80);  // recursion available
+      response[7] = 1;                        // one answer
+      const unsigned char answer[] = {
+        0xc0, 0x0c,  // the name of the question
+        0, 1, 0, 1,  // A, IN
+        static_cast<unsigned char>(kTtlSeconds >> 24), static_cast<unsigned char>(kTtlSeconds >> 16),
+        static_cast<unsigned char>(kTtlSeconds >> 8), static_cast<unsigned char>(kTtlSeconds),
+        0, 4,
+      };
+      response.append(reinterpret_cast<const char*>(answer), sizeof answer);
+      struct in_addr ip;
+      ::inet_pton(AF_INET, kAddress, &ip);
+      response.append(reinterpret_cast<const char*>(&ip), sizeof ip);
+      ::sendto(sockfd_, response.data(), response.size(), 0,
+               reinterpret_cast<struct sockaddr*>(&peer), peerLen);
+    }
+  }
+
+  const int sockfd_;
+  InetAddress address_;
+  std::atomic<int> numAnswered_;
+  std::atomic<int> numIgnored_;
+  std::thread thread_;
+};
+
+bool isAnswer(const std::vector<InetAddress>& addrs)
+{
+  return addrs.size() == 1 && addrs[0].toIpPort() == string(kAddress) + ":80";
+}
+
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::ERROR);
+  StandInNameserver nameserver;
+
+  EventLoop loop;
+  Resolver::Options options;
+  options.timeoutSeconds = 0.1;
+  options.retries = 1;
+  Resolver resolver(&loop, options);
+  resolver.setNameserver(nameserver.address());
+  check(resolver.nameserver().toIpPort() == nameserver.address().toIpPort(),
+        "setNameserver() takes the stand-in");
+
+  std::thread other;
+  loop.runInLoop([&] {
+    resolver.resolve(kName, 80, [&](const std::vector<InetAddress>& addrs) {
+      check(isAnswer(addrs), "answer of the nameserver");
+      check(resolver.numQueriesSent() == 1 && resolver.cacheSize() == 1,
+            "one query sent, the answer cached");
+
+      bool called = false;
+      resolver.resolve(kName, 80, [&](const std::vector<InetAddress>& cached) {
+        called = isAnswer(cached);
+      });
+      check(called && resolver.numQueriesSent() == 1,
+            "answered from the cache, before returning");
+    });
+  });
+
+  loop.runAfter(kTtlSeconds + 0.3, [&] {
+    resolver.resolve(kName, 80, [&](const std::vector<InetAddress>& addrs) {
+      check(isAnswer(addrs) && resolver.numQueriesSent() == 2
+            && nameserver.numAnswered() == 2,
+            "asked again once the TTL expired");
+
+      Timestamp start(Timestamp::now());
+      resolver.resolve(kSilentName, 80, [&, start](const std::vector<InetAddress>& none) {
+        double elapsed = timeDifference(Timestamp::now(), start);
+        check(none.empty(), "empty result for a name never answered");
+        check(nameserver.numIgnored() == 1 + options.retries,
+              "sent once and retried");
+        check(elapsed >= options.timeoutSeconds * (1 + options.retries) - 0.01,
+              "given up after every attempt timed out");
+
+        other = std::thread([&] {
+          std::vector<InetAddress> addrs = resolver.resolve(kName, 80).get();
+          check(isAnswer(addrs), "resolve() from another thread");
+          loop.quit();
+        });
+      });
+    });
+  });
+
+  loop.loop();
+  other.join();
+  printf("%s\n", failures == 0 ? "PASSED" : "FAILED");
+  return failures == 0 ? 0 : 1;
+}